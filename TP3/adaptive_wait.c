@@ -0,0 +1,53 @@
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "adaptive_wait.h"
+
+#define SPIN_LIMIT_MIN 16
+#define SPIN_LIMIT_MAX 65536
+#define YIELD_LIMIT    4
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield")
+#else
+#define cpu_relax() __asm__ __volatile__("" ::: "memory")
+#endif
+
+static long           n_processors;
+static pthread_once_t n_processors_once = PTHREAD_ONCE_INIT;
+
+static void n_processors_init(void) {
+  n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+int adaptive_wait(int * spin_limit, int (*ready)(void *), void * arg) {
+  int limit = __atomic_load_n(spin_limit, __ATOMIC_RELAXED);
+  int i;
+
+  pthread_once(&n_processors_once, n_processors_init);
+
+  if (n_processors > 1) {
+    for (i = 0; i < limit; i++) {
+      if (ready(arg)) {
+        // Move the limit towards twice the observed wait
+        limit = limit + (2 * i - limit) / 8;
+        if (limit < SPIN_LIMIT_MIN) limit = SPIN_LIMIT_MIN;
+        if (limit > SPIN_LIMIT_MAX) limit = SPIN_LIMIT_MAX;
+        __atomic_store_n(spin_limit, limit, __ATOMIC_RELAXED);
+        return 1;
+      }
+      cpu_relax();
+    }
+    limit = limit / 2;
+    if (limit < SPIN_LIMIT_MIN) limit = SPIN_LIMIT_MIN;
+    __atomic_store_n(spin_limit, limit, __ATOMIC_RELAXED);
+  }
+
+  for (i = 0; i < YIELD_LIMIT; i++) {
+    sched_yield();
+    if (ready(arg)) return 1;
+  }
+  return 0;
+}
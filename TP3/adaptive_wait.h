@@ -0,0 +1,19 @@
+#ifndef ADAPTIVE_WAIT_H
+#define ADAPTIVE_WAIT_H
+
+// Waiting policies of the protected buffer blocking operations
+#define PARK_POLICY 0 // park immediately (default)
+#define SPIN_POLICY 1 // spin, then yield, then park
+
+// Before parking, spin with a pause instruction until ready(arg)
+// returns true, but for no more than *spin_limit iterations, then
+// yield the processor a few times. Return whether ready(arg) became
+// true. *spin_limit is tuned after each call: it moves towards twice
+// the number of iterations that were needed when the spin succeeded
+// and it is halved when it failed. Spinning is skipped on a single
+// processor.
+int adaptive_wait(int * spin_limit, int (*ready)(void *), void * arg);
+
+// Initial value of a spin limit
+#define SPIN_LIMIT_INIT 1024
+#endif
@@ -0,0 +1,44 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+#include <pthread.h>
+#include <time.h>
+
+// An eventcount lets threads wait for a condition evaluated by a
+// lock-free structure. A waiter announces itself with
+// eventcount_prepare_wait, checks the condition again and then either
+// cancels or waits for the epoch to change. A notifier bumps the epoch
+// and takes the mutex only when a waiter has announced itself, so that
+// notifying nobody costs a fence and a load.
+typedef struct {
+  unsigned int    epoch;
+  int             waiters;
+  pthread_mutex_t m;
+  pthread_cond_t  cond;
+} eventcount_t;
+
+// Initialise the eventcount structure above.
+void eventcount_init(eventcount_t * ec);
+
+// Release the resources of the eventcount structure above. Nobody
+// may wait on it anymore.
+void eventcount_destroy(eventcount_t * ec);
+
+// Announce the calling thread as a waiter and return the current
+// epoch, to be passed to eventcount_wait.
+unsigned int eventcount_prepare_wait(eventcount_t * ec);
+
+// Withdraw the announcement made by eventcount_prepare_wait when the
+// condition turned out to be true.
+void eventcount_cancel_wait(eventcount_t * ec);
+
+// Block until the epoch differs from key, but no longer than abstime
+// when it is not NULL. Withdraw the announcement. Return ETIMEDOUT on
+// timeout, 0 otherwise.
+int eventcount_wait(eventcount_t * ec, unsigned int key, struct timespec * abstime);
+
+// Wake up one waiter, if any.
+void eventcount_notify(eventcount_t * ec);
+
+// Wake up all waiters, if any.
+void eventcount_notify_all(eventcount_t * ec);
+#endif
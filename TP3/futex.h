@@ -0,0 +1,12 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+#include <time.h>
+// Sleep while *word equals val, but no longer than the absolute
+// CLOCK_MONOTONIC time abstime when it is not NULL. Return ETIMEDOUT
+// on timeout. May return spuriously, the caller checks word again.
+// Without futex (DARWIN), poll word every 1ms.
+int futex_wait(unsigned int * word, unsigned int val, const struct timespec * abstime);
+
+// Wake up at most n threads sleeping on word
+void futex_wake(unsigned int * word, int n);
+#endif
@@ -0,0 +1,58 @@
+#ifndef FUTEX_PROTECTED_BUFFER_H
+#define FUTEX_PROTECTED_BUFFER_H
+#include <pthread.h>
+#include <stdlib.h>
+#include "protected_buffer.h"
+
+// Initialise the protected buffer structure above. Timeouts of poll
+// and offer are absolute realtime dates as for the other
+// implementations, they are translated into monotonic ones on entry.
+protected_buffer_t * futex_protected_buffer_init(int length);
+
+// Extract an element from buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+void * futex_protected_buffer_get(protected_buffer_t * b);
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int futex_protected_buffer_put(protected_buffer_t * b, void * d);
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, return NULL. Otherwise, return the element.
+void * futex_protected_buffer_remove(protected_buffer_t * b);
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, return 0. Otherwise, return 1.
+int futex_protected_buffer_add(protected_buffer_t * b, void * d);
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return the element if
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
+void * futex_protected_buffer_poll(protected_buffer_t * b, struct timespec * abstime);
+
+// Insert an element into buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int futex_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime);
+
+// Close buffer and wake up all the waiting threads.
+void futex_protected_buffer_close(protected_buffer_t * b);
+
+// Free buffer. No thread may use it anymore.
+void futex_protected_buffer_destroy(protected_buffer_t * b);
+
+// No batch operations of its own: the elements are moved one at a
+// time (see protected_buffer.h).
+#define futex_protected_buffer_put_all  protected_buffer_put_each
+#define futex_protected_buffer_add_n    protected_buffer_add_each
+#define futex_protected_buffer_drain_to protected_buffer_remove_each
+#define futex_protected_buffer_poll_n   protected_buffer_poll_each
+
+// Operations of this implementation, registered in protected_buffer.c
+extern const protected_buffer_ops_t futex_protected_buffer_ops;
+#endif
@@ -2,11 +2,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "protected_buffer.h"
+#include "cond_protected_buffer.h"
 #include "sem_protected_buffer.h"
+#include "value_protected_buffer.h"
 #include "utils.h"
 
 //A rendre avant le 20/03 23h59
@@ -16,13 +20,26 @@
 //Pour les questions ouvertes répondre en commentaire
 
 protected_buffer_t * protected_buffer;
+value_protected_buffer_t * value_protected_buffer;
 pthread_t * tasks;
 
+// Time spent by consumers in buffer operations and number of these
+// operations, to compare waiting policies.
+long consumer_wait_ns;
+long consumer_ops;
+
+// Return the elapsed nanoseconds between t0 and t1
+long elapsed_ns(struct timespec * t0, struct timespec * t1) {
+  return (t1->tv_sec - t0->tv_sec) * 1000000000L + (t1->tv_nsec - t0->tv_nsec);
+}
+
 // Main consumer. Get consumer id as argument.
 void * main_consumer(void * arg){
   int   i;
   int * id = (int *) arg;
   int * data;
+  int   value;
+  struct timespec t0, t1;
 
   printf ("start consumer %d\n", *id);
 
@@ -37,18 +54,39 @@ void * main_consumer(void * arg){
     // the previous deadline + one period
     add_millis_to_timespec (&deadline, consumer_period);
     resynchronize();
-    switch (sem_consumers) {
-    case BLOCKING:
-      data = (int *) protected_buffer_get(protected_buffer);
-      break;
-    case NONBLOCKING:
-      data = (int *) protected_buffer_remove(protected_buffer);
-      break;
-    case TIMEDOUT:
-      data = (int *) protected_buffer_poll(protected_buffer, &deadline);
-      break;
-    default:;
+    data = NULL;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (by_value) {
+      // Values are copied out of the buffer, nothing to free
+      switch (sem_consumers) {
+      case BLOCKING:
+        value_protected_buffer_get(value_protected_buffer, &value);
+        break;
+      case NONBLOCKING:
+        value_protected_buffer_remove(value_protected_buffer, &value);
+        break;
+      case TIMEDOUT:
+        value_protected_buffer_poll(value_protected_buffer, &value, &deadline);
+        break;
+      default:;
+      }
+    } else {
+      switch (sem_consumers) {
+      case BLOCKING:
+        data = (int *) protected_buffer_get(protected_buffer);
+        break;
+      case NONBLOCKING:
+        data = (int *) protected_buffer_remove(protected_buffer);
+        break;
+      case TIMEDOUT:
+        data = (int *) protected_buffer_poll(protected_buffer, &deadline);
+        break;
+      default:;
+      }
     }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    __atomic_add_fetch(&consumer_wait_ns, elapsed_ns(&t0, &t1), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&consumer_ops, 1, __ATOMIC_RELAXED);
     if (data != NULL) free(data);
     delay_until (&deadline);
   }
@@ -60,7 +98,8 @@ void * main_consumer(void * arg){
 void * main_producer(void * arg){
   int   i;
   int * id = (int *) arg;
-  int * data;
+  int * data = NULL;
+  int   value;
   long  done;
 
   printf ("start producer %d\n", *id);
@@ -73,34 +112,55 @@ void * main_producer(void * arg){
   
   for (i=0; i<(n_values/n_producers); i++) {
 
-    // Allocate data in order to produce and consume it
-    data = (int *)malloc(sizeof(int));
-
     // Data is split in two parts : first the thread number and the
     // number of data produced.
-    *data=*(int *)(arg) * 100 + i;
+    value = *(int *)(arg) * 100 + i;
+
+    // Allocate data in order to produce and consume it, unless it is
+    // sent by value.
+    if (!by_value) {
+      data = (int *)malloc(sizeof(int));
+      *data = value;
+    }
     
     // Behave as a periodic task. the current deadline corresponds to
     // the previous deadline + one period.
     add_millis_to_timespec (&deadline, producer_period);
     resynchronize();
     
-    switch (sem_producers) {
-    case BLOCKING:
-      protected_buffer_put(protected_buffer, data);
-      done=1;
-      break;
-      
-    case NONBLOCKING:
-      done=protected_buffer_add(protected_buffer, data);
-      break;
-      
-    case TIMEDOUT:
-      done=protected_buffer_offer(protected_buffer, data, &deadline);
-      break;
-    default:;
+    done = 1;
+    if (by_value) {
+      switch (sem_producers) {
+      case BLOCKING:
+        value_protected_buffer_put(value_protected_buffer, &value);
+        break;
+
+      case NONBLOCKING:
+        done=value_protected_buffer_add(value_protected_buffer, &value);
+        break;
+
+      case TIMEDOUT:
+        done=value_protected_buffer_offer(value_protected_buffer, &value, &deadline);
+        break;
+      default:;
+      }
+    } else {
+      switch (sem_producers) {
+      case BLOCKING:
+        protected_buffer_put(protected_buffer, data);
+        break;
+
+      case NONBLOCKING:
+        done=protected_buffer_add(protected_buffer, data);
+        break;
+
+      case TIMEDOUT:
+        done=protected_buffer_offer(protected_buffer, data, &deadline);
+        break;
+      default:;
+      }
+      if (!done) free(data);
     }
-    if (!done) data = NULL;
     delay_until (&deadline);
   }
   pthread_exit (NULL);
@@ -113,8 +173,9 @@ void read_file(char * filename);
 int main(int argc, char *argv[]){
   int   i;
   int * data;
-
-  tasks = malloc((n_producers+n_consumers) * sizeof(int)); //init tasks with sizes of producers and consumers
+  struct rusage   usage;
+  struct timespec t0, t1;
+  long            n_wakeups, n_wakeups_avoided;
 
   if (argc != 2) {
     printf("Usage : %s <scenario file>\n", argv[0]);
@@ -123,11 +184,19 @@ int main(int argc, char *argv[]){
 
   init_utils();
   read_file(argv[1]);
-  
-  protected_buffer = protected_buffer_init(sem_impl, buffer_size);
+
+  tasks = malloc((n_producers+n_consumers) * sizeof(pthread_t)); //init tasks with sizes of producers and consumers
+
+  if (by_value)
+    value_protected_buffer = value_protected_buffer_init(buffer_size, sizeof(int));
+  else {
+    protected_buffer = protected_buffer_init(sem_impl, buffer_size);
+    protected_buffer_set_wait_policy(protected_buffer, wait_policy);
+  }
 
 
   set_start_time();
+  clock_gettime(CLOCK_MONOTONIC, &t0);
   
   // Create consumers and then producers. Pass the *value* of i
   // as parametre of the main procedure (main_consumer or main_producer).
@@ -146,6 +215,21 @@ int main(int argc, char *argv[]){
   for (i=0; i<n_consumers+n_producers; i++) {
     pthread_join(tasks[i],NULL);
   }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  // Report the average time spent by a consumer in the buffer and the
+  // processor time consumed, to be compared with the elapsed time.
+  getrusage(RUSAGE_SELF, &usage);
+  printf ("consumer wait = %ld us, cpu = %ld ms, elapsed = %ld ms\n",
+          consumer_ops ? consumer_wait_ns / consumer_ops / 1000 : 0,
+          (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000
+          + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000,
+          elapsed_ns(&t0, &t1) / 1000000);
+
+  if (!by_value && (sem_impl == COND_IMPL)) {
+    cond_protected_buffer_wakeups(protected_buffer, &n_wakeups, &n_wakeups_avoided);
+    printf ("wakeups = %ld, wakeups avoided = %ld\n", n_wakeups, n_wakeups_avoided);
+  }
 }
 
 void read_file(char * filename){
@@ -188,5 +272,13 @@ void read_file(char * filename){
   get_string (file, "#producer_period", __FILE__, __LINE__);
   get_long   (file, (long *) &producer_period, __FILE__, __LINE__);
   printf ("producer_period = %ld\n", producer_period);
+
+  // Optional: send ints by value (no allocation per item)
+  get_optional_long (file, "#by_value", &by_value);
+  printf ("by_value = %ld\n", by_value);
+
+  // Optional: waiting policy of the protected buffer
+  get_optional_long (file, "#wait_policy", &wait_policy);
+  printf ("wait_policy = %ld\n", wait_policy);
 }
 
@@ -0,0 +1,199 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "eventcount.h"
+#include "mpmc_queue.h"
+#include "protected_buffer.h"
+#include "mpmc_protected_buffer.h"
+#include "utils.h"
+
+// State of the implementation, the impl field of protected_buffer_t
+typedef struct {
+  mpmc_queue_t * queue;
+  eventcount_t   not_empty, not_full; //waiting consumers and producers
+} mpmc_protected_buffer_t;
+
+#define MPMC(b) ((mpmc_protected_buffer_t *) ((protected_buffer_t *) (b))->impl)
+
+// Implementation based on a bounded lock-free queue for multiple
+// producers and consumers. Non-blocking operations (remove, add)
+// never take a lock. Blocking operations wait on eventcounts,
+// not_empty for consumers and not_full for producers, which are
+// notified after each successful operation. A notification takes a
+// lock only when a thread is actually waiting. Closing the buffer
+// notifies all the waiting threads of both eventcounts.
+
+static int mpmc_closed(protected_buffer_t * b){
+  return __atomic_load_n(&(b->closed), __ATOMIC_SEQ_CST);
+}
+
+static int mpmc_not_empty(void * arg){
+  return (mpmc_queue_size(MPMC(arg)->queue) > 0)
+    || mpmc_closed((protected_buffer_t *) arg);
+}
+
+static int mpmc_not_full(void * arg){
+  mpmc_queue_t * q = MPMC(arg)->queue;
+  return (mpmc_queue_size(q) < (long) q->capacity)
+    || mpmc_closed((protected_buffer_t *) arg);
+}
+
+// Extract an element. When blocking, wait until there is one, but no
+// longer than abstime when it is not NULL. Return
+// PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+static void * mpmc_get(protected_buffer_t * b, int blocking, struct timespec * abstime){
+  void *       d;
+  unsigned int key;
+  int          spun = 0;
+
+  while ((d = mpmc_queue_get(MPMC(b)->queue)) == NULL) {
+    if (!blocking) return NULL;
+    // Elements inserted before close are visible once closed is
+    if (mpmc_closed(b)) {
+      if ((d = mpmc_queue_get(MPMC(b)->queue)) != NULL) break;
+      return PROTECTED_BUFFER_CLOSED;
+    }
+    if (protected_buffer_spin(b, mpmc_not_empty, &spun, NULL)) continue;
+    key = eventcount_prepare_wait(&(MPMC(b)->not_empty));
+    if (((d = mpmc_queue_get(MPMC(b)->queue)) != NULL) || mpmc_closed(b)) {
+      eventcount_cancel_wait(&(MPMC(b)->not_empty));
+      if (d == NULL) continue;
+      break;
+    }
+    if (eventcount_wait(&(MPMC(b)->not_empty), key, abstime) == ETIMEDOUT) {
+      d = mpmc_queue_get(MPMC(b)->queue);
+      if (d == NULL) return NULL;
+      break;
+    }
+  }
+  eventcount_notify(&(MPMC(b)->not_full));
+  return d;
+}
+
+// Insert an element. When blocking, wait until there is room, but no
+// longer than abstime when it is not NULL. Return 0 if not successful
+// or closed.
+static int mpmc_put(protected_buffer_t * b, void * d, int blocking, struct timespec * abstime){
+  unsigned int key;
+  int          spun = 0;
+
+  if (mpmc_closed(b)) return 0;
+  while (!mpmc_queue_put(MPMC(b)->queue, d)) {
+    if (!blocking) return 0;
+    if (protected_buffer_spin(b, mpmc_not_full, &spun, NULL)) continue;
+    key = eventcount_prepare_wait(&(MPMC(b)->not_full));
+    if (mpmc_closed(b)) {
+      eventcount_cancel_wait(&(MPMC(b)->not_full));
+      return 0;
+    }
+    if (mpmc_queue_put(MPMC(b)->queue, d)) {
+      eventcount_cancel_wait(&(MPMC(b)->not_full));
+      break;
+    }
+    if (eventcount_wait(&(MPMC(b)->not_full), key, abstime) == ETIMEDOUT) {
+      if (!mpmc_queue_put(MPMC(b)->queue, d)) return 0;
+      break;
+    }
+  }
+  eventcount_notify(&(MPMC(b)->not_empty));
+  return 1;
+}
+
+// Initialise the protected buffer structure above.
+protected_buffer_t * mpmc_protected_buffer_init(int length) {
+  protected_buffer_t * b;
+  b = protected_buffer_alloc(sizeof(mpmc_protected_buffer_t));
+  MPMC(b)->queue = mpmc_queue_init(length);
+  eventcount_init(&(MPMC(b)->not_empty));
+  eventcount_init(&(MPMC(b)->not_full));
+  return b;
+}
+
+// Extract an element from buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+void * mpmc_protected_buffer_get(protected_buffer_t * b){
+  void * d = mpmc_get(b, 1, NULL);
+  print_task_activity ("get", (d == PROTECTED_BUFFER_CLOSED) ? NULL : d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int mpmc_protected_buffer_put(protected_buffer_t * b, void * d){
+  int done = mpmc_put(b, d, 1, NULL);
+  print_task_activity ("put", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, return NULL. Otherwise, return the element.
+void * mpmc_protected_buffer_remove(protected_buffer_t * b){
+  void * d = mpmc_get(b, 0, NULL);
+  print_task_activity ("remove", d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, return 0. Otherwise, return 1.
+int mpmc_protected_buffer_add(protected_buffer_t * b, void * d){
+  int done = mpmc_put(b, d, 0, NULL);
+  print_task_activity ("add", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return the element if
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
+void * mpmc_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
+  void * d = mpmc_get(b, 1, abstime);
+  print_task_activity ("poll", (d == PROTECTED_BUFFER_CLOSED) ? NULL : d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int mpmc_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
+  int done = mpmc_put(b, d, 1, abstime);
+  print_task_activity ("offer", done ? d : NULL);
+  return done;
+}
+
+// Close buffer and wake up all the waiting threads at once.
+void mpmc_protected_buffer_close(protected_buffer_t * b){
+  __atomic_store_n(&(b->closed), 1, __ATOMIC_SEQ_CST);
+  eventcount_notify_all(&(MPMC(b)->not_empty));
+  eventcount_notify_all(&(MPMC(b)->not_full));
+}
+
+// Free buffer and its synchronisation components.
+void mpmc_protected_buffer_destroy(protected_buffer_t * b){
+  mpmc_queue_destroy(MPMC(b)->queue);
+  eventcount_destroy(&(MPMC(b)->not_empty));
+  eventcount_destroy(&(MPMC(b)->not_full));
+  protected_buffer_free(b);
+}
+
+// Operations of this implementation, registered in protected_buffer.c
+const protected_buffer_ops_t mpmc_protected_buffer_ops = {
+  "mpmc",
+  mpmc_protected_buffer_init,
+  mpmc_protected_buffer_get,
+  mpmc_protected_buffer_put,
+  mpmc_protected_buffer_remove,
+  mpmc_protected_buffer_add,
+  mpmc_protected_buffer_poll,
+  mpmc_protected_buffer_offer,
+  mpmc_protected_buffer_put_all,
+  mpmc_protected_buffer_add_n,
+  mpmc_protected_buffer_drain_to,
+  mpmc_protected_buffer_poll_n,
+  mpmc_protected_buffer_close,
+  mpmc_protected_buffer_destroy
+};
@@ -0,0 +1,93 @@
+#include <stdlib.h>
+#include "mpmc_queue.h"
+
+mpmc_queue_t * mpmc_queue_init(int size) {
+  mpmc_queue_t * q = (mpmc_queue_t *)malloc(sizeof(mpmc_queue_t));
+  unsigned long length = 2;
+  unsigned long i;
+
+  // Round the cell array up to the next power of two. With a single
+  // cell, a written cell could not be told from a free one.
+  while (length < (unsigned long) size) length = length << 1;
+  q->cells = (mpmc_cell_t *)malloc(length * sizeof(mpmc_cell_t));
+  for (i = 0; i < length; i++)
+    q->cells[i].sequence = i;
+  q->mask = length - 1;
+  q->capacity = (size > 0) ? (unsigned long) size : 0;
+  q->enqueue_pos = 0;
+  q->dequeue_pos = 0;
+  return q;
+}
+
+void mpmc_queue_destroy(mpmc_queue_t * q) {
+  free(q->cells);
+  free(q);
+}
+
+// A cell at position pos can be written when its sequence equals pos
+// and read when it equals pos + 1. Once read, its sequence is set to
+// pos + mask + 1, the next position mapped to the same cell.
+
+int mpmc_queue_put(mpmc_queue_t * q, void * d) {
+  mpmc_cell_t * cell;
+  unsigned long pos = __atomic_load_n(&(q->enqueue_pos), __ATOMIC_RELAXED);
+  long          diff;
+  long          used;
+
+  while (1) {
+    // Admit no more than capacity elements. pos may be stale: once
+    // consumers have moved past it, reload it rather than wrap around.
+    used = (long) (pos - __atomic_load_n(&(q->dequeue_pos), __ATOMIC_RELAXED));
+    if (used < 0) {
+      pos = __atomic_load_n(&(q->enqueue_pos), __ATOMIC_RELAXED);
+      continue;
+    }
+    if (used >= (long) q->capacity)
+      return 0;
+    cell = &(q->cells[pos & q->mask]);
+    diff = (long) (__atomic_load_n(&(cell->sequence), __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&(q->enqueue_pos), &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      // The cell has not been read since the previous lap: full
+      return 0;
+    } else {
+      pos = __atomic_load_n(&(q->enqueue_pos), __ATOMIC_RELAXED);
+    }
+  }
+  cell->data = d;
+  __atomic_store_n(&(cell->sequence), pos + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+void * mpmc_queue_get(mpmc_queue_t * q) {
+  mpmc_cell_t * cell;
+  unsigned long pos = __atomic_load_n(&(q->dequeue_pos), __ATOMIC_RELAXED);
+  long          diff;
+  void *        d;
+
+  while (1) {
+    cell = &(q->cells[pos & q->mask]);
+    diff = (long) (__atomic_load_n(&(cell->sequence), __ATOMIC_ACQUIRE) - (pos + 1));
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&(q->dequeue_pos), &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      // The cell has not been written yet: empty
+      return NULL;
+    } else {
+      pos = __atomic_load_n(&(q->dequeue_pos), __ATOMIC_RELAXED);
+    }
+  }
+  d = cell->data;
+  __atomic_store_n(&(cell->sequence), pos + q->mask + 1, __ATOMIC_RELEASE);
+  return d;
+}
+
+int mpmc_queue_size(mpmc_queue_t * q) {
+  return __atomic_load_n(&(q->enqueue_pos), __ATOMIC_RELAXED)
+    - __atomic_load_n(&(q->dequeue_pos), __ATOMIC_RELAXED);
+}
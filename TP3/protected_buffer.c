@@ -1,64 +1,138 @@
+#include <string.h>
 #include "protected_buffer.h"
 #include "cond_protected_buffer.h"
 #include "sem_protected_buffer.h"
+#include "spsc_protected_buffer.h"
+#include "mpmc_protected_buffer.h"
+#include "futex_protected_buffer.h"
 
-// Initialise the protected buffer structure above. sem_impl specifies
-// whether the implementation is a semaphore based implementation.
-protected_buffer_t * protected_buffer_init(long sem_impl, int length) {
+// Implementations indexed by their selector in protected_buffer.h. A
+// new implementation only needs to be declared here.
+static const protected_buffer_ops_t * protected_buffer_impls[] = {
+  &cond_protected_buffer_ops,  // COND_IMPL
+  &sem_protected_buffer_ops,   // SEM_IMPL
+  &spsc_protected_buffer_ops,  // SPSC_IMPL
+  &mpmc_protected_buffer_ops,  // MPMC_IMPL
+  &futex_protected_buffer_ops  // FUTEX_IMPL
+};
+
+#define N_IMPLS ((long) (sizeof(protected_buffer_impls) / sizeof(protected_buffer_impls[0])))
+
+// With PROTECTED_BUFFER_IMPL, PB_OP(b, get) expands to the function
+// <impl>_protected_buffer_get. Otherwise, it is read in the table of
+// operations of b.
+#ifdef PROTECTED_BUFFER_IMPL
+#define PB_PASTE(impl, op) impl ## _protected_buffer_ ## op
+#define PB_BIND(impl, op)  PB_PASTE(impl, op)
+#define PB_OP(b, op)       PB_BIND(PROTECTED_BUFFER_IMPL, op)
+#define PB_OPS             PB_BIND(PROTECTED_BUFFER_IMPL, ops)
+#else
+#define PB_OP(b, op)       ((b)->ops->op)
+#endif
+
+// Initialise a protected buffer with the given operations.
+static protected_buffer_t * protected_buffer_init_ops(const protected_buffer_ops_t * ops,
+                                                      int length) {
   protected_buffer_t * b;
-  if (sem_impl)
-    b = sem_protected_buffer_init(length);
-  else
-    b = cond_protected_buffer_init(length);
-  b->sem_impl = sem_impl;
+#ifdef PROTECTED_BUFFER_IMPL
+  ops = &PB_OPS;
+  b = PB_BIND(PROTECTED_BUFFER_IMPL, init)(length);
+#else
+  b = ops->init(length);
+#endif
+  b->ops = ops;
+  b->closed = 0;
+  b->size = length;
+  b->wait_policy = PARK_POLICY;
+  b->spin_limit = SPIN_LIMIT_INIT;
+  return b;
+}
+
+protected_buffer_t * protected_buffer_alloc(size_t impl_size) {
+  protected_buffer_t * b = (protected_buffer_t *) malloc(sizeof(protected_buffer_t));
+
+  if (posix_memalign(&(b->impl), 64, impl_size) != 0) {
+    free(b);
+    return NULL;
+  }
   return b;
 }
 
+void protected_buffer_free(protected_buffer_t * b) {
+  free(b->impl);
+  free(b);
+}
+
+// Initialise the protected buffer structure above. impl selects one
+// of the implementations declared in protected_buffer.h.
+protected_buffer_t * protected_buffer_init(long impl, int length) {
+  if ((impl < 0) || (impl >= N_IMPLS)) impl = COND_IMPL;
+  return protected_buffer_init_ops(protected_buffer_impls[impl], length);
+}
+
+// Initialise the protected buffer structure above with the
+// implementation of the given name.
+protected_buffer_t * protected_buffer_init_by_name(char * name, int length) {
+  long impl;
+
+  for (impl = 0; impl < N_IMPLS; impl++)
+    if (strcmp(protected_buffer_impls[impl]->name, name) == 0)
+      return protected_buffer_init_ops(protected_buffer_impls[impl], length);
+  return NULL;
+}
+
+// Select how blocking operations wait.
+void protected_buffer_set_wait_policy(protected_buffer_t * b, int policy){
+  b->wait_policy = policy;
+}
+
+// With SPIN_POLICY, spin once per blocking operation before parking.
+int protected_buffer_spin(protected_buffer_t * b, int (*ready)(void *), int * spun,
+                          pthread_mutex_t * m){
+  int rc;
+
+  if ((b->wait_policy != SPIN_POLICY) || *spun) return 0;
+  *spun = 1;
+  if (m != NULL) pthread_mutex_unlock(m);
+  rc = adaptive_wait(&(b->spin_limit), ready, b);
+  if (m != NULL) pthread_mutex_lock(m);
+  // Once m was released, the buffer may have changed anyway
+  return rc || (m != NULL);
+}
+
 // Extract an element from buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
 void * protected_buffer_get(protected_buffer_t * b){
-  if (b->sem_impl)
-    return sem_protected_buffer_get(b);
-  else
-    return cond_protected_buffer_get(b);
+  return PB_OP(b, get)(b);
 }
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
-void protected_buffer_put(protected_buffer_t * b, void * d){
-  if (b->sem_impl)
-    sem_protected_buffer_put(b, d);
-  else
-    cond_protected_buffer_put(b, d);
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int protected_buffer_put(protected_buffer_t * b, void * d){
+  return PB_OP(b, put)(b, d);
 }
 
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, return NULL. Otherwise, return the element.
 void * protected_buffer_remove(protected_buffer_t * b){
-  if (b->sem_impl)
-    return sem_protected_buffer_remove(b);
-  else
-    return cond_protected_buffer_remove(b);
+  return PB_OP(b, remove)(b);
 }
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, return 0. Otherwise, return 1.
 int protected_buffer_add(protected_buffer_t * b, void * d){
-  if (b->sem_impl)
-    return sem_protected_buffer_add(b, d);
-  else
-    return cond_protected_buffer_add(b, d);
+  return PB_OP(b, add)(b, d);
 }
 
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, the method call blocks until it is, but
 // waits no longer than the given timeout. Return the element if
-// successful. Otherwise, return NULL.
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
 void * protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
-  if (b->sem_impl)
-    return sem_protected_buffer_poll(b, abstime);
-  else
-    return cond_protected_buffer_poll(b, abstime);
+  return PB_OP(b, poll)(b, abstime);
 }
 
 // Insert an element into buffer. If the attempted operation is not
@@ -66,9 +140,72 @@ void * protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
 // waits no longer than the given timeout. Return 0 if not
 // successful. Otherwise, return 1.
 int protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
-  if (b->sem_impl)
-    return sem_protected_buffer_offer(b, d, abstime);
-  else
-    return cond_protected_buffer_offer(b, d, abstime);
+  return PB_OP(b, offer)(b, d, abstime);
 }
 
+// Implementations without batch operations move the elements one at
+// a time with the single element operations above.
+
+int protected_buffer_put_each(protected_buffer_t * b, void ** d, int n){
+  int done = 0;
+  while ((done < n) && protected_buffer_put(b, d[done])) done++;
+  return done;
+}
+
+int protected_buffer_add_each(protected_buffer_t * b, void ** d, int n){
+  int done = 0;
+  while ((done < n) && protected_buffer_add(b, d[done])) done++;
+  return done;
+}
+
+int protected_buffer_remove_each(protected_buffer_t * b, void ** out, int max){
+  int done = 0;
+  while ((done < max) && ((out[done] = protected_buffer_remove(b)) != NULL)) done++;
+  return done;
+}
+
+int protected_buffer_poll_each(protected_buffer_t * b, void ** out, int max,
+                               struct timespec * abstime){
+  if (max == 0) return 0;
+  if (abstime == NULL) return protected_buffer_remove_each(b, out, max);
+  out[0] = protected_buffer_poll(b, abstime);
+  if ((out[0] == NULL) || (out[0] == PROTECTED_BUFFER_CLOSED)) return 0;
+  return 1 + protected_buffer_remove_each(b, &out[1], max - 1);
+}
+
+// Insert the n elements of d into buffer. If there is not enough
+// room, the method call blocks until there is. Return the number of
+// elements inserted, n unless the buffer is closed.
+int protected_buffer_put_all(protected_buffer_t * b, void ** d, int n){
+  return PB_OP(b, put_all)(b, d, n);
+}
+
+// Insert the first elements of d, at most n, into buffer. Do not
+// block. Return the number of elements inserted.
+int protected_buffer_add_n(protected_buffer_t * b, void ** d, int n){
+  return PB_OP(b, add_n)(b, d, n);
+}
+
+// Extract at most max elements from buffer into out. Do not block.
+// Return the number of elements extracted.
+int protected_buffer_drain_to(protected_buffer_t * b, void ** out, int max){
+  return PB_OP(b, drain_to)(b, out, max);
+}
+
+// Extract at most max elements from buffer into out. If the buffer is
+// empty, the method call blocks until it is not, but waits no longer
+// than the given timeout. Return the number of elements extracted.
+int protected_buffer_poll_n(protected_buffer_t * b, void ** out, int max,
+                            struct timespec * abstime){
+  return PB_OP(b, poll_n)(b, out, max, abstime);
+}
+
+// Close buffer and wake up all the waiting threads at once.
+void protected_buffer_close(protected_buffer_t * b){
+  PB_OP(b, close)(b);
+}
+
+// Free buffer with the operation of its implementation.
+void protected_buffer_destroy(protected_buffer_t * b){
+  PB_OP(b, destroy)(b);
+}
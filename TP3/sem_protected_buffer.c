@@ -1,5 +1,4 @@
 #include <errno.h>
-#include <fcntl.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <stdlib.h>
@@ -7,140 +6,186 @@
 #include <sys/time.h>
 #include "circular_buffer.h"
 #include "protected_buffer.h"
+#include "sem_protected_buffer.h"
 #include "utils.h"
 
-#define EMPTY_SLOTS_NAME "/empty_slots"
-#define FULL_SLOTS_NAME "/full_slots"
+// State of the implementation, the impl field of protected_buffer_t
+typedef struct {
+  sem_t               s_empty, s_full; //empty and full slots
+  pthread_mutex_t     s_get_m, s_put_m; //consumers and producers mutual exclusions
+  circular_buffer_t * buffer;
+} sem_protected_buffer_t;
 
-// Initialise the protected buffer structure above. 
+#define SEM(b) ((sem_protected_buffer_t *) ((protected_buffer_t *) (b))->impl)
+
+// The number of empty and full slots are counted by two unnamed,
+// process-private semaphores. Once a slot is reserved, a producer only
+// accesses tail and a consumer only accesses head, so producers and
+// consumers use separate mutual exclusions and do not contend with
+// each other. With a single producer and a single consumer, both
+// mutexes stay uncontended.
+//
+// Closing the buffer posts one extra token on each semaphore. A thread
+// that finds the buffer closed once it holds a token passes the token
+// on with another post, so that every waiting thread wakes up in turn.
+
+static int sem_not_empty(void * arg){
+  int value;
+  sem_getvalue(&(SEM(arg)->s_full), &value);
+  return value > 0;
+}
+
+static int sem_not_full(void * arg){
+  int value;
+  sem_getvalue(&(SEM(arg)->s_empty), &value);
+  return value > 0;
+}
+
+// The store in sem_protected_buffer_close is made in the producers
+// mutual exclusion, so once it is seen, no more element is inserted.
+static int sem_closed(protected_buffer_t * b){
+  return __atomic_load_n(&(b->closed), __ATOMIC_ACQUIRE);
+}
+
+// Decrement semaphore s. When blocking, wait until it is possible,
+// but no longer than abstime when it is not NULL. Return 0 if
+// successful, -1 otherwise.
+static int sem_acquire(protected_buffer_t * b, sem_t * s, int (*ready)(void *),
+                       int blocking, struct timespec * abstime){
+  int spun = 0;
+  int rc;
+
+  while (sem_trywait(s) != 0) {
+    if (!blocking) return -1;
+    if (protected_buffer_spin(b, ready, &spun, NULL)) continue;
+    if (abstime == NULL)
+      rc = sem_wait(s);
+    else
+      rc = sem_timedwait(s, abstime);
+    if (rc == 0) return 0;
+    if (errno != EINTR) return -1;
+  }
+  return 0;
+}
+
+// Initialise the protected buffer structure above.
 protected_buffer_t * sem_protected_buffer_init(int length) {
   protected_buffer_t * b;
-  b = (protected_buffer_t *)malloc(sizeof(protected_buffer_t));
-  b->buffer = circular_buffer_init(length);
+  b = protected_buffer_alloc(sizeof(sem_protected_buffer_t));
+  SEM(b)->buffer = circular_buffer_init(length);
   // Initialize the synchronization attributes
-  // Use these filenames as named semaphores
-  sem_unlink (EMPTY_SLOTS_NAME);
-  sem_unlink (FULL_SLOTS_NAME);
-  // Open the semaphores using the filenames above
-  sem_unlink(EMPTY_SLOTS_NAME);
-  sem_unlink(FULL_SLOTS_NAME);
-  sem_init(&(b->s_m),0,1); //semaphore mutex
-  //semaphore conditions variables
-  sem_init(&(b->s_full),0,0);
-  sem_init(&(b->s_empty),0,length);
+  sem_init(&(SEM(b)->s_full),0,0);
+  sem_init(&(SEM(b)->s_empty),0,length);
+  pthread_mutex_init(&(SEM(b)->s_get_m),NULL);
+  pthread_mutex_init(&(SEM(b)->s_put_m),NULL);
   return b;
 }
 
-// Extract an element from buffer. If the attempted operation is
-// not possible immedidately, the method call blocks until it is.
-void * sem_protected_buffer_get(protected_buffer_t * b){
+// Extract an element, the full slot being already reserved. Return
+// PROTECTED_BUFFER_CLOSED when the slot is the token of a closed and
+// empty buffer.
+static void * sem_dequeue(protected_buffer_t * b, char * action){
   void * d;
-  
-  // Enforce synchronisation semantics using semaphores.
-  sem_wait(&(b->s_full));
+
   // Enter mutual exclusion.
-  sem_wait(&(b->s_m));
-  d = circular_buffer_get(b->buffer);
-  print_task_activity ("get", d);
+  pthread_mutex_lock(&(SEM(b)->s_get_m));
+  if (sem_closed(b) && (circular_buffer_size(SEM(b)->buffer) == 0)) {
+    pthread_mutex_unlock(&(SEM(b)->s_get_m));
+    sem_post(&(SEM(b)->s_full));
+    print_task_activity (action, NULL);
+    return PROTECTED_BUFFER_CLOSED;
+  }
+  d = circular_buffer_dequeue(SEM(b)->buffer);
+  print_task_activity (action, d);
 
   // Leave mutual exclusion.
-  sem_post(&(b->s_m));
+  pthread_mutex_unlock(&(SEM(b)->s_get_m));
+
   // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_empty));
+  sem_post(&(SEM(b)->s_empty));
   return d;
 }
 
-// Insert an element into buffer. If the attempted operation is
-// not possible immedidately, the method call blocks until it is.
-void sem_protected_buffer_put(protected_buffer_t * b, void * d){
+// Insert an element, the empty slot being already reserved. Return 0
+// when the buffer is closed. Otherwise, return 1.
+static int sem_enqueue(protected_buffer_t * b, void * d, char * action){
 
-  // Enforce synchronisation semantics using semaphores.
-  sem_wait(&(b->s_empty));
   // Enter mutual exclusion.
-  sem_wait(&(b->s_m));
-  circular_buffer_put(b->buffer, d);
-  print_task_activity ("put", d);
+  pthread_mutex_lock(&(SEM(b)->s_put_m));
+  if (b->closed) {
+    pthread_mutex_unlock(&(SEM(b)->s_put_m));
+    sem_post(&(SEM(b)->s_empty));
+    print_task_activity (action, NULL);
+    return 0;
+  }
+  circular_buffer_enqueue(SEM(b)->buffer, d);
+  print_task_activity (action, d);
 
   // Leave mutual exclusion.
-  sem_post(&(b->s_m));
+  pthread_mutex_unlock(&(SEM(b)->s_put_m));
+
   // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_full));
+  sem_post(&(SEM(b)->s_full));
+  return 1;
 }
 
-// Extract an element from buffer. If the attempted operation is not
-// possible immedidately, return NULL. Otherwise, return the element.
-void * sem_protected_buffer_remove(protected_buffer_t * b){
-  void * d = NULL;
-  int    rc = -1;
-  
+// Extract an element from buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+void * sem_protected_buffer_get(protected_buffer_t * b){
   // Enforce synchronisation semantics using semaphores.
-  rc = sem_trywait(&(b->s_full));
-  if (rc != 0) {
-    print_task_activity ("remove", d);
-    return d;
+  sem_acquire(b, &(SEM(b)->s_full), sem_not_empty, 1, NULL);
+  return sem_dequeue(b, "get");
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+int sem_protected_buffer_put(protected_buffer_t * b, void * d){
+  if (sem_closed(b)) {
+    print_task_activity ("put", NULL);
+    return 0;
   }
+  // Enforce synchronisation semantics using semaphores.
+  sem_acquire(b, &(SEM(b)->s_empty), sem_not_full, 1, NULL);
+  return sem_enqueue(b, d, "put");
+}
 
-  // Enter mutual exclusion.
-  sem_trywait(&(b->s_m));
-  d = circular_buffer_get(b->buffer);
-  print_task_activity ("remove", d);
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, return NULL. Otherwise, return the element.
+void * sem_protected_buffer_remove(protected_buffer_t * b){
+  void * d;
 
-  // Leave mutual exclusion.
-  sem_post(&(b->s_m));
   // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_empty));
-  return d;
+  if (sem_acquire(b, &(SEM(b)->s_full), sem_not_empty, 0, NULL) != 0) {
+    print_task_activity ("remove", NULL);
+    return NULL;
+  }
+  d = sem_dequeue(b, "remove");
+  return (d == PROTECTED_BUFFER_CLOSED) ? NULL : d;
 }
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, return 0. Otherwise, return 1.
 int sem_protected_buffer_add(protected_buffer_t * b, void * d){
-  int rc = -1;
-  
   // Enforce synchronisation semantics using semaphores.
-  rc = sem_trywait(&(b->s_empty));
-  if (rc != 0) {
+  if (sem_closed(b) || (sem_acquire(b, &(SEM(b)->s_empty), sem_not_full, 0, NULL) != 0)) {
     print_task_activity ("add", NULL);
     return 0;
   }
-
-  // Enter mutual exclusion.
-  sem_trywait(&(b->s_m));
-  circular_buffer_put(b->buffer, d);
-  print_task_activity ("add", d);
-  
-  // Leave mutual exclusion.
-  sem_post(&(b->s_m));
-  // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_m));
-  return 1;
+  return sem_enqueue(b, d, "add");
 }
 
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, the method call blocks until it is, but
 // waits no longer than the given timeout. Return the element if
-// successful. Otherwise, return NULL.
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
 void * sem_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
-  void * d = NULL;
-  int    rc = -1;
-  
   // Enforce synchronisation semantics using semaphores.
-  rc = sem_timedwait(&(b->s_full),abstime);
-  if (rc != 0) {
-    print_task_activity ("poll", d);
-    return d;
+  if (sem_acquire(b, &(SEM(b)->s_full), sem_not_empty, 1, abstime) != 0) {
+    print_task_activity ("poll", NULL);
+    return NULL;
   }
-
-  // Enter mutual exclusion. 
-  sem_wait(&(b->s_m));
-  d = circular_buffer_get(b->buffer);
-  print_task_activity ("poll", d);
-
-  // Leave mutual exclusion.
-  sem_post(&(b->s_m));
-  // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_empty));
-  return d;
+  return sem_dequeue(b, "poll");
 }
 
 // Insert an element into buffer. If the attempted operation is not
@@ -148,25 +193,172 @@ void * sem_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstim
 // waits no longer than the given timeout. Return 0 if not
 // successful. Otherwise, return 1.
 int sem_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
-  int rc = -1;
-  
   // Enforce synchronisation semantics using semaphores.
-  rc = sem_timedwait(&(b->s_empty),abstime);
-  if (rc != 0) {
-    d = NULL;
-    print_task_activity ("offer", d);
+  if (sem_closed(b) || (sem_acquire(b, &(SEM(b)->s_empty), sem_not_full, 1, abstime) != 0)) {
+    print_task_activity ("offer", NULL);
+    return 0;
+  }
+  return sem_enqueue(b, d, "offer");
+}
+
+// Reserve between one and max slots counted by semaphore s. Block
+// (but no longer than abstime when it is not NULL) for the first slot
+// only when blocking is set, then take the others without blocking.
+// Return the number of slots reserved.
+static int sem_reserve(protected_buffer_t * b, sem_t * s, int (*ready)(void *),
+                       int max, int blocking, struct timespec * abstime){
+  int done = 0;
+
+  if (max == 0) return 0;
+  if (sem_acquire(b, s, ready, blocking, abstime) != 0) return 0;
+  done = 1;
+  while ((done < max) && (sem_trywait(s) == 0)) done++;
+  return done;
+}
+
+// Insert the n elements of d into buffer. If there is not enough
+// room, the method call blocks until there is. The elements are
+// inserted in runs of reserved slots, each one under a single
+// acquisition of the mutual exclusion. Return the number of elements
+// inserted, n unless the buffer is closed.
+int sem_protected_buffer_put_all(protected_buffer_t * b, void ** d, int n){
+  int done = 0;
+  int run;
+  int i;
+
+  while ((done < n) && !sem_closed(b)) {
+    // Enforce synchronisation semantics using semaphores.
+    run = sem_reserve(b, &(SEM(b)->s_empty), sem_not_full, n - done, 1, NULL);
+
+    // Enter mutual exclusion.
+    pthread_mutex_lock(&(SEM(b)->s_put_m));
+    if (b->closed) {
+      pthread_mutex_unlock(&(SEM(b)->s_put_m));
+      for (i = 0; i < run; i++) sem_post(&(SEM(b)->s_empty));
+      break;
+    }
+    for (i = 0; i < run; i++) circular_buffer_enqueue(SEM(b)->buffer, d[done + i]);
+    print_task_activity ("put_all", NULL);
+
+    // Leave mutual exclusion.
+    pthread_mutex_unlock(&(SEM(b)->s_put_m));
+
+    // Enforce synchronisation semantics using semaphores.
+    for (i = 0; i < run; i++) sem_post(&(SEM(b)->s_full));
+    done += run;
+  }
+  return done;
+}
+
+// Insert the first elements of d, at most n, into buffer. Do not
+// block. The elements are inserted under a single acquisition of the
+// mutual exclusion. Return the number of elements inserted.
+int sem_protected_buffer_add_n(protected_buffer_t * b, void ** d, int n){
+  int done;
+  int i;
+
+  // Enforce synchronisation semantics using semaphores.
+  if (sem_closed(b)) done = 0;
+  else done = sem_reserve(b, &(SEM(b)->s_empty), sem_not_full, n, 0, NULL);
+  if (done == 0) {
+    print_task_activity ("add_n", NULL);
     return 0;
   }
 
   // Enter mutual exclusion.
-  sem_wait(&(b->s_m));
-  circular_buffer_put(b->buffer, d);
-  print_task_activity ("offer", d);
+  pthread_mutex_lock(&(SEM(b)->s_put_m));
+  if (b->closed) {
+    pthread_mutex_unlock(&(SEM(b)->s_put_m));
+    for (i = 0; i < done; i++) sem_post(&(SEM(b)->s_empty));
+    print_task_activity ("add_n", NULL);
+    return 0;
+  }
+  for (i = 0; i < done; i++) circular_buffer_enqueue(SEM(b)->buffer, d[i]);
+  print_task_activity ("add_n", NULL);
 
   // Leave mutual exclusion.
-  sem_post(&(b->s_m));
+  pthread_mutex_unlock(&(SEM(b)->s_put_m));
+
   // Enforce synchronisation semantics using semaphores.
-  sem_post(&(b->s_full));
-  return 1;
+  for (i = 0; i < done; i++) sem_post(&(SEM(b)->s_full));
+  return done;
+}
+
+// Extract at most max elements from buffer into out. Do not block.
+// Return the number of elements extracted.
+int sem_protected_buffer_drain_to(protected_buffer_t * b, void ** out, int max){
+  return sem_protected_buffer_poll_n(b, out, max, NULL);
+}
+
+// Extract at most max elements from buffer into out. If the buffer is
+// empty, the method call blocks until it is not, but waits no longer
+// than the given timeout. When abstime is NULL, do not block. Return
+// the number of elements extracted.
+int sem_protected_buffer_poll_n(protected_buffer_t * b, void ** out, int max,
+                                struct timespec * abstime){
+  int reserved;
+  int done;
+  int i;
+
+  // Enforce synchronisation semantics using semaphores.
+  reserved = sem_reserve(b, &(SEM(b)->s_full), sem_not_empty, max, abstime != NULL, abstime);
+  if (reserved == 0) {
+    print_task_activity ("poll_n", NULL);
+    return 0;
+  }
+
+  // Enter mutual exclusion. Once the buffer is closed, a reserved slot
+  // may be the token posted by close rather than an element.
+  pthread_mutex_lock(&(SEM(b)->s_get_m));
+  done = reserved;
+  if (sem_closed(b) && (circular_buffer_size(SEM(b)->buffer) < done))
+    done = circular_buffer_size(SEM(b)->buffer);
+  for (i = 0; i < done; i++) out[i] = circular_buffer_dequeue(SEM(b)->buffer);
+  print_task_activity ("poll_n", NULL);
+
+  // Leave mutual exclusion.
+  pthread_mutex_unlock(&(SEM(b)->s_get_m));
+
+  // Enforce synchronisation semantics using semaphores.
+  for (i = 0; i < done; i++) sem_post(&(SEM(b)->s_empty));
+  for (i = done; i < reserved; i++) sem_post(&(SEM(b)->s_full));
+  return done;
+}
+
+// Close buffer and wake up all the waiting threads. A single token is
+// posted on each semaphore and passed on by each thread it wakes up.
+void sem_protected_buffer_close(protected_buffer_t * b){
+  pthread_mutex_lock(&(SEM(b)->s_put_m));
+  __atomic_store_n(&(b->closed), 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&(SEM(b)->s_put_m));
+  sem_post(&(SEM(b)->s_full));
+  sem_post(&(SEM(b)->s_empty));
+}
+
+// Free buffer and its synchronisation components.
+void sem_protected_buffer_destroy(protected_buffer_t * b){
+  circular_buffer_destroy(SEM(b)->buffer);
+  sem_destroy(&(SEM(b)->s_full));
+  sem_destroy(&(SEM(b)->s_empty));
+  pthread_mutex_destroy(&(SEM(b)->s_get_m));
+  pthread_mutex_destroy(&(SEM(b)->s_put_m));
+  protected_buffer_free(b);
 }
 
+// Operations of this implementation, registered in protected_buffer.c
+const protected_buffer_ops_t sem_protected_buffer_ops = {
+  "sem",
+  sem_protected_buffer_init,
+  sem_protected_buffer_get,
+  sem_protected_buffer_put,
+  sem_protected_buffer_remove,
+  sem_protected_buffer_add,
+  sem_protected_buffer_poll,
+  sem_protected_buffer_offer,
+  sem_protected_buffer_put_all,
+  sem_protected_buffer_add_n,
+  sem_protected_buffer_drain_to,
+  sem_protected_buffer_poll_n,
+  sem_protected_buffer_close,
+  sem_protected_buffer_destroy
+};
@@ -9,7 +9,7 @@
 
 pthread_key_t task_info_key;
 
-long sem_impl;        // Use the semaphore implementation or not
+long sem_impl;        // Protected buffer implementation (see protected_buffer.h)
 long sem_producers;   // Sem for prod BLOCKING 0, NONBLOCKING 1, TIMEDOUT 2
 long sem_consumers;   // Sem for cons BLOCKING 0, NONBLOCKING 1, TIMEDOUT 2
 long buffer_size;     // Size of the protected buffer
@@ -18,6 +18,8 @@ long n_consumers;     // Number of consumers
 long n_producers;     // Number of producers
 long consumer_period; // Period of consumer (millis)
 long producer_period; // Period of producer (millis)
+long by_value;        // Send ints by value rather than allocated pointers
+long wait_policy;     // Protected buffer waiting policy (see adaptive_wait.h)
 
 pthread_mutex_t m; //mutex for delay implementation
 pthread_cond_t c; //condition for delay implementation
@@ -193,6 +195,28 @@ int get_long (FILE * f, long * l, char * file, int line) {
   return 0;
 }
 
+// Look for optional string s in file f and read the long that follows
+// it into l. If s is not found, leave l unchanged and return 0.
+// Restore the file position in any case, so that the optional strings
+// may appear in any order.
+int get_optional_long (FILE * f, char * s, long * l) {
+  char b[64];
+  char * c;
+  long position = ftell (f);
+  int  found = 0;
+
+  while (fgets (b, 64, f) != NULL) {
+    c = strchr (b, '\n');
+    if (c != NULL) *c = '\0';
+    if (strcmp (s, b) == 0) {
+      found = get_long (f, l, __FILE__, __LINE__);
+      break;
+    }
+  }
+  fseek (f, position, SEEK_SET);
+  return found;
+}
+
 #ifdef DARWIN
 int pthread_mutex_timedlock(pthread_mutex_t * mutex, const struct timespec * abs_timeout)
 {
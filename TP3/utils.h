@@ -22,7 +22,7 @@ int pthread_mutex_timedlock(pthread_mutex_t * mutex, const struct timespec * abs
 
 extern pthread_key_t task_info_key;
 
-extern long sem_impl;        // Use the semaphore implementation or not
+extern long sem_impl;        // Protected buffer implementation (see protected_buffer.h)
 extern long sem_producers;   // Sem prod BLOCKING 0, NONBLOCKING 1, TIMEDOUT 2
 extern long sem_consumers;   // Sem cons BLOCKING 0, NONBLOCKING 1, TIMEDOUT 2
 extern long buffer_size;     // Size of the protected buffer
@@ -31,6 +31,8 @@ extern long n_consumers;     // Number of consumers
 extern long n_producers;     // Number of producers
 extern long consumer_period; // Period of consumer (millis)
 extern long producer_period; // Period of producer (millis)
+extern long by_value;        // Send ints by value rather than pointers
+extern long wait_policy;     // Waiting policy (see adaptive_wait.h)
 
 // Initialize the data structure used in this unti
 void init_utils();
@@ -62,4 +64,9 @@ int get_long (FILE * f, long * l, char * file, int line);
 // Read string in file f and store it in s. If there is an error,
 // provide filename and line number (file:line).
 int get_string (FILE * f, char * s, char * file, int line);
+
+// Look for optional string s in file f and read the long that follows
+// it into l. If s is not found, leave l unchanged and return 0. The
+// file position is left unchanged.
+int get_optional_long (FILE * f, char * s, long * l);
 #endif
@@ -0,0 +1,37 @@
+#include <stdlib.h>
+#include <string.h>
+#include "value_buffer.h"
+
+value_buffer_t * value_buffer_init(int max_size, int elem_size) {
+  value_buffer_t * b =
+    (value_buffer_t *)malloc(sizeof(value_buffer_t));
+  unsigned int length = 1;
+
+  // Round the slot array up to the next power of two
+  while (length < (unsigned int) max_size) length = length << 1;
+  b->head = 0;
+  b->tail = 0;
+  b->mask = length - 1;
+  b->max_size = max_size;
+  b->elem_size = elem_size;
+  b->buffer = (char *)malloc(length * elem_size);
+  return b;
+}
+
+int value_buffer_get(value_buffer_t * b, void * d){
+  if (b->tail == b->head) return 0;
+  memcpy(d, &b->buffer[(b->head & b->mask) * b->elem_size], b->elem_size);
+  b->head++;
+  return 1;
+}
+
+int value_buffer_put(value_buffer_t * b, const void * d){
+  if (b->tail - b->head == (unsigned int) b->max_size) return 0;
+  memcpy(&b->buffer[(b->tail & b->mask) * b->elem_size], d, b->elem_size);
+  b->tail++;
+  return 1;
+}
+
+int value_buffer_size(value_buffer_t * b) {
+  return b->tail - b->head;
+}
@@ -0,0 +1,27 @@
+#ifndef VALUE_BUFFER_H
+#define VALUE_BUFFER_H
+// Circular buffer storing fixed-size elements by value rather than
+// pointers to them. elem_size is chosen at initialisation and the
+// elements are copied in and out of the slot array. As for
+// circular_buffer_t, the slot array is a power of two indexed with a
+// mask and head and tail are free-running counters.
+typedef struct {
+  unsigned int head, tail, mask;
+  int          max_size;
+  int          elem_size;
+  char *       buffer;
+} value_buffer_t;
+
+// Allocate and initialize a value buffer of size elements of
+// elem_size bytes.
+value_buffer_t * value_buffer_init(int size, int elem_size);
+
+// Remove an element from value buffer and copy it into d. When
+// empty, return 0.
+int value_buffer_get(value_buffer_t * b, void * d);
+
+// Append a copy of element d into value buffer. When full, return 0.
+int value_buffer_put(value_buffer_t * b, const void * d);
+
+int value_buffer_size(value_buffer_t * b);
+#endif
@@ -0,0 +1,102 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "value_buffer.h"
+#include "value_protected_buffer.h"
+#include "utils.h"
+
+// Initialise the protected buffer structure above.
+value_protected_buffer_t * value_protected_buffer_init(int length, int elem_size) {
+  value_protected_buffer_t * b;
+  b = (value_protected_buffer_t *)malloc(sizeof(value_protected_buffer_t));
+  b->buffer = value_buffer_init(length, elem_size);
+  pthread_mutex_init(&(b->m),NULL);
+  pthread_cond_init(&(b->empty),NULL);
+  pthread_cond_init(&(b->full),NULL);
+  return b;
+}
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, the method call blocks until it is.
+void value_protected_buffer_get(value_protected_buffer_t * b, void * d){
+  pthread_mutex_lock(&(b->m));
+  while (value_buffer_get(b->buffer, d) == 0)
+    pthread_cond_wait(&(b->full), &(b->m));
+  pthread_cond_broadcast(&(b->empty));
+  print_task_activity ("get", (int *) d);
+  pthread_mutex_unlock(&(b->m));
+}
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, the method call blocks until it is.
+void value_protected_buffer_put(value_protected_buffer_t * b, const void * d){
+  pthread_mutex_lock(&(b->m));
+  while (value_buffer_put(b->buffer, d) == 0)
+    pthread_cond_wait(&(b->empty), &(b->m));
+  pthread_cond_broadcast(&(b->full));
+  print_task_activity ("put", (int *) d);
+  pthread_mutex_unlock(&(b->m));
+}
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, return 0. Otherwise, return 1.
+int value_protected_buffer_remove(value_protected_buffer_t * b, void * d){
+  int done;
+
+  pthread_mutex_lock(&(b->m));
+  done = value_buffer_get(b->buffer, d);
+  if (done) pthread_cond_broadcast(&(b->empty));
+  print_task_activity ("remove", done ? (int *) d : NULL);
+  pthread_mutex_unlock(&(b->m));
+  return done;
+}
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, return 0. Otherwise, return 1.
+int value_protected_buffer_add(value_protected_buffer_t * b, const void * d){
+  int done;
+
+  pthread_mutex_lock(&(b->m));
+  done = value_buffer_put(b->buffer, d);
+  if (done) pthread_cond_broadcast(&(b->full));
+  print_task_activity ("add", done ? (int *) d : NULL);
+  pthread_mutex_unlock(&(b->m));
+  return done;
+}
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, the method call blocks until it is,
+// but waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int value_protected_buffer_poll(value_protected_buffer_t * b, void * d,
+                                struct timespec * abstime){
+  int done;
+  int rc = 0;
+
+  pthread_mutex_lock(&(b->m));
+  while (((done = value_buffer_get(b->buffer, d)) == 0) && (rc != ETIMEDOUT))
+    rc = pthread_cond_timedwait(&(b->full), &(b->m), abstime);
+  if (done) pthread_cond_broadcast(&(b->empty));
+  print_task_activity ("poll", done ? (int *) d : NULL);
+  pthread_mutex_unlock(&(b->m));
+  return done;
+}
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, the method call blocks until it is,
+// but waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int value_protected_buffer_offer(value_protected_buffer_t * b, const void * d,
+                                 struct timespec * abstime){
+  int done;
+  int rc = 0;
+
+  pthread_mutex_lock(&(b->m));
+  while (((done = value_buffer_put(b->buffer, d)) == 0) && (rc != ETIMEDOUT))
+    rc = pthread_cond_timedwait(&(b->empty), &(b->m), abstime);
+  if (done) pthread_cond_broadcast(&(b->full));
+  print_task_activity ("offer", done ? (int *) d : NULL);
+  pthread_mutex_unlock(&(b->m));
+  return done;
+}
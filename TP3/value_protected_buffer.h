@@ -0,0 +1,49 @@
+#ifndef VALUE_PROTECTED_BUFFER_H
+#define VALUE_PROTECTED_BUFFER_H
+#include <pthread.h>
+#include <stdlib.h>
+#include "value_buffer.h"
+
+// Protected buffer whose elements are copied by value into a value
+// buffer. Producers and consumers do not need to allocate an element
+// per item. The synchronisation is based on condition variables.
+typedef struct {
+  pthread_cond_t   empty,full;
+  pthread_mutex_t  m;
+  value_buffer_t * buffer;
+} value_protected_buffer_t;
+
+// Initialise the protected buffer structure above with length
+// elements of elem_size bytes.
+value_protected_buffer_t * value_protected_buffer_init(int length, int elem_size);
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, the method call blocks until it is.
+void value_protected_buffer_get(value_protected_buffer_t * b, void * d);
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, the method call blocks until it is.
+void value_protected_buffer_put(value_protected_buffer_t * b, const void * d);
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, return 0. Otherwise, return 1.
+int value_protected_buffer_remove(value_protected_buffer_t * b, void * d);
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, return 0. Otherwise, return 1.
+int value_protected_buffer_add(value_protected_buffer_t * b, const void * d);
+
+// Extract an element from buffer into d. If the attempted operation
+// is not possible immedidately, the method call blocks until it is,
+// but waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int value_protected_buffer_poll(value_protected_buffer_t * b, void * d,
+                                struct timespec * abstime);
+
+// Insert a copy of element d into buffer. If the attempted operation
+// is not possible immedidately, the method call blocks until it is,
+// but waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int value_protected_buffer_offer(value_protected_buffer_t * b, const void * d,
+                                 struct timespec * abstime);
+#endif
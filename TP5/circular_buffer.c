@@ -1,41 +1,93 @@
 #include <stdlib.h>
+#include <string.h>
 #include "circular_buffer.h"
 
 circular_buffer_t * circular_buffer_init(int max_size) {
-  circular_buffer_t * b =
-    (circular_buffer_t *)malloc(sizeof(circular_buffer_t));
-  b->first = 0;
-  b->last  = -1;
-  b->size = 0;
+  circular_buffer_t * b;
+  unsigned int length = 1;
+
+  // head and tail are each on their own cache line
+  if (posix_memalign((void **) &b, 64, sizeof(circular_buffer_t)) != 0) return NULL;
+
+  // Round the slot array up to the next power of two
+  while (length < (unsigned int) max_size) length = length << 1;
+  b->head = 0;
+  b->tail = 0;
+  b->mask = length - 1;
   b->max_size = max_size;
-  b->buffer = (void *)malloc(max_size*sizeof(void *));
+  b->buffer = (void *)malloc(length*sizeof(void *));
   return b;
 }
 
+void circular_buffer_destroy(circular_buffer_t * b) {
+  free(b->buffer);
+  free(b);
+}
+
 void * circular_buffer_get(circular_buffer_t * b){
   void * d;
-  if (b->size == 0) return NULL;
-  d = b->buffer[b->first];
-  b->first = (b-> first + 1) % b->max_size;
-  b->size--;
+  if (b->tail == b->head) return NULL;
+  d = b->buffer[b->head & b->mask];
+  b->head++;
   return d;
 }
 
 void * circular_buffer_read(circular_buffer_t * b) {
-  if (b->size == 0) return NULL;
-  return b->buffer[b->first];
+  if (b->tail == b->head) return NULL;
+  return b->buffer[b->head & b->mask];
 }
 
 
 int circular_buffer_put(circular_buffer_t * b, void * d){
-  if (b->size == b->max_size) return 0;
-  b->last = (b->last + 1) % b->max_size;
-  b->buffer[b->last] = d;
-  b->size++;
+  if (b->tail - b->head == (unsigned int) b->max_size) return 0;
+  b->buffer[b->tail & b->mask] = d;
+  b->tail++;
   return 1;
 }
 
+void * circular_buffer_dequeue(circular_buffer_t * b){
+  void * d = b->buffer[b->head & b->mask];
+  b->head++;
+  return d;
+}
+
+void circular_buffer_enqueue(circular_buffer_t * b, void * d){
+  b->buffer[b->tail & b->mask] = d;
+  b->tail++;
+}
+
+// Copy n slots starting at counter index from (or to) d. The run is
+// split in two when it wraps around the end of the slot array.
+static void circular_buffer_copy(circular_buffer_t * b, unsigned int index,
+                                 void ** d, int n, int to_buffer) {
+  unsigned int first = index & b->mask;
+  unsigned int run   = b->mask + 1 - first;
+  if (run > (unsigned int) n) run = n;
+  if (to_buffer) {
+    memcpy(&b->buffer[first], d, run * sizeof(void *));
+    memcpy(b->buffer, &d[run], (n - run) * sizeof(void *));
+  } else {
+    memcpy(d, &b->buffer[first], run * sizeof(void *));
+    memcpy(&d[run], b->buffer, (n - run) * sizeof(void *));
+  }
+}
+
+int circular_buffer_get_n(circular_buffer_t * b, void ** d, int n){
+  int size = b->tail - b->head;
+  if (n > size) n = size;
+  circular_buffer_copy(b, b->head, d, n, 0);
+  b->head += n;
+  return n;
+}
+
+int circular_buffer_put_n(circular_buffer_t * b, void ** d, int n){
+  int room = b->max_size - (int) (b->tail - b->head);
+  if (n > room) n = room;
+  circular_buffer_copy(b, b->tail, d, n, 1);
+  b->tail += n;
+  return n;
+}
+
 int circular_buffer_size(circular_buffer_t * b) {
-  return b->size;
+  return b->tail - b->head;
 }
-   
@@ -1,13 +1,26 @@
 #ifndef CIRCULAR_BUFFER_H
 #define CIRCULAR_BUFFER_H
+// The slot array is rounded up to a power of two so that an index is
+// obtained with a mask rather than a modulo. head and tail are
+// free-running counters (they are never wrapped), the number of
+// elements is tail - head and max_size remains the logical capacity.
 typedef struct {
-  int first, last, size, max_size;
-  void ** buffer;
+  unsigned int mask;
+  int          max_size;
+  void **      buffer;
+  // head and tail sit on separate cache lines so that a lock-free
+  // consumer and producer (spsc_protected_buffer) do not keep on
+  // stealing the same line from each other.
+  unsigned int head __attribute__((aligned(64)));
+  unsigned int tail __attribute__((aligned(64)));
 } circular_buffer_t;
 
 // Allocate and initialize the circular buffer structure
 circular_buffer_t * circular_buffer_init(int size);
 
+// Free the circular buffer structure and its slots
+void circular_buffer_destroy(circular_buffer_t * b);
+
 // Remove an element from circular buffer. When empty, return NULL.
 void * circular_buffer_get(circular_buffer_t * b);
 
@@ -18,5 +31,23 @@ void * circular_buffer_read(circular_buffer_t * b);
 // Append an element into circular buffer. When full, return 0.
 int circular_buffer_put(circular_buffer_t * b, void * d);
 
+// Remove an element from circular buffer. The caller guarantees that
+// the buffer is not empty (the elements are counted by a semaphore for
+// instance). Only head is accessed, so that a consumer may run
+// concurrently with a producer calling circular_buffer_enqueue.
+void * circular_buffer_dequeue(circular_buffer_t * b);
+
+// Append an element into circular buffer. The caller guarantees that
+// the buffer is not full. Only tail is accessed.
+void circular_buffer_enqueue(circular_buffer_t * b, void * d);
+
+// Remove at most n elements from circular buffer and copy them into
+// d. Return the number of elements removed.
+int circular_buffer_get_n(circular_buffer_t * b, void ** d, int n);
+
+// Append at most n elements from d into circular buffer. Return the
+// number of elements appended.
+int circular_buffer_put_n(circular_buffer_t * b, void ** d, int n);
+
 int circular_buffer_size(circular_buffer_t * b);
 #endif
@@ -4,67 +4,146 @@
 #include <stdio.h>
 #include "circular_buffer.h"
 #include "protected_buffer.h"
+#include "cond_protected_buffer.h"
 #include "utils.h"
 
+// State of the implementation, the impl field of protected_buffer_t
+typedef struct {
+  pthread_cond_t      empty, full; //empty and full slots available
+  pthread_mutex_t     m;
+  int                 n_waiting_consumers, n_waiting_producers; //threads blocked on full and on empty
+  long                n_wakeups, n_wakeups_avoided; //threads woken up, notifications skipped
+  circular_buffer_t * buffer;
+} cond_protected_buffer_t;
+
+#define COND(b) ((cond_protected_buffer_t *) ((protected_buffer_t *) (b))->impl)
+
+// Consumers wait on full (a full slot becomes available) and
+// producers wait on empty (an empty slot becomes available). Each
+// side is counted while it waits, so that an operation signals only
+// when somebody is waiting and wakes up no more threads than it
+// released elements or slots. Once the buffer is closed, both sides
+// are woken up and no longer wait.
+
 // Initialise the protected buffer structure above.
 protected_buffer_t * cond_protected_buffer_init(int length) {
   protected_buffer_t * b;
-  b = (protected_buffer_t *)malloc(sizeof(protected_buffer_t));
-  b->buffer = circular_buffer_init(length);
+  b = protected_buffer_alloc(sizeof(cond_protected_buffer_t));
+  COND(b)->buffer = circular_buffer_init(length);
   // Initialize the synchronization components
 
-  pthread_mutex_init(&(b->m),NULL); //Init lock with default attributs
-  pthread_cond_init(&(b->empty),NULL); //Init condition for empty buffer
-  pthread_cond_init(&(b->full),NULL); //Init condition for full buffer
+  pthread_mutex_init(&(COND(b)->m),NULL); //Init lock with default attributs
+  pthread_cond_init(&(COND(b)->empty),NULL); //Init condition for empty buffer
+  pthread_cond_init(&(COND(b)->full),NULL); //Init condition for full buffer
+  COND(b)->n_waiting_consumers = 0;
+  COND(b)->n_waiting_producers = 0;
+  COND(b)->n_wakeups = 0;
+  COND(b)->n_wakeups_avoided = 0;
 
   return b;
 }
 
+// Hints read outside mutual exclusion, checked again once in it
+static int cond_not_empty(void * arg){
+  circular_buffer_t * c = COND(arg)->buffer;
+  return (__atomic_load_n(&(c->tail), __ATOMIC_RELAXED)
+          != __atomic_load_n(&(c->head), __ATOMIC_RELAXED))
+    || __atomic_load_n(&(((protected_buffer_t *) arg)->closed), __ATOMIC_RELAXED);
+}
+
+static int cond_not_full(void * arg){
+  circular_buffer_t * c = COND(arg)->buffer;
+  return (__atomic_load_n(&(c->tail), __ATOMIC_RELAXED)
+          - __atomic_load_n(&(c->head), __ATOMIC_RELAXED) != (unsigned int) c->max_size)
+    || __atomic_load_n(&(((protected_buffer_t *) arg)->closed), __ATOMIC_RELAXED);
+}
+
+// Block on cond while being counted in n_waiting, but no longer than
+// abstime when it is not NULL. Return ETIMEDOUT on timeout. Called in
+// mutual exclusion.
+static int cond_block(protected_buffer_t * b, pthread_cond_t * cond,
+                      int * n_waiting, struct timespec * abstime){
+  int rc = 0;
+
+  (*n_waiting)++;
+  if (abstime == NULL)
+    pthread_cond_wait(cond, &(COND(b)->m));
+  else
+    rc = pthread_cond_timedwait(cond, &(COND(b)->m), abstime);
+  (*n_waiting)--;
+  return rc;
+}
+
+// Wake up one waiting thread per released element or slot, but no
+// more than there are waiting threads. Count the notifications that
+// were not needed. Called in mutual exclusion.
+static void cond_wakeup(protected_buffer_t * b, pthread_cond_t * cond,
+                        int n_waiting, int n_released){
+  int i;
+
+  if (n_waiting == 0) {
+    COND(b)->n_wakeups_avoided++;
+    return;
+  }
+  if (n_released >= n_waiting) {
+    pthread_cond_broadcast(cond);
+    COND(b)->n_wakeups += n_waiting;
+  } else {
+    for (i = 0; i < n_released; i++) pthread_cond_signal(cond);
+    COND(b)->n_wakeups += n_released;
+  }
+}
+
 // Extract an element from buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
 void * cond_protected_buffer_get(protected_buffer_t * b){
   void * d;
+  int    spun = 0;
   // Enter mutual exclusion
-  pthread_mutex_lock(&(b->m));
+  pthread_mutex_lock(&(COND(b)->m));
   // Wait until there is a full slot to get data from the unprotected
   // circular buffer (circular_buffer_get).
-  while ((d = circular_buffer_get(b->buffer)) == NULL) { //makes thread wait until data is available
-    pthread_cond_wait(&(b->full), &(b->m)); //block thread until a slot full
+  while ((d = circular_buffer_get(COND(b)->buffer)) == NULL) { //makes thread wait until data is available
+    if (b->closed) break;
+    if (protected_buffer_spin(b, cond_not_empty, &spun, &(COND(b)->m))) continue;
+    cond_block(b, &(COND(b)->full), &(COND(b)->n_waiting_consumers), NULL); //block thread until a slot full
   }
 
-  // Signal or broadcast that an empty slot is available in the
-  // unprotected circular buffer (if needed)
-  pthread_cond_broadcast(&(b->empty)); //releases threads blocked and waiting for empty condition
+  // Signal that an empty slot is available in the unprotected
+  // circular buffer (if needed)
+  if (d != NULL) cond_wakeup(b, &(COND(b)->empty), COND(b)->n_waiting_producers, 1);
 
   print_task_activity ("get", d);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //unlock m
-  return d;
+  pthread_mutex_unlock(&(COND(b)->m)); //unlock m
+  return (d == NULL) ? PROTECTED_BUFFER_CLOSED : d;
 }
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
-void cond_protected_buffer_put(protected_buffer_t * b, void * d){
+int cond_protected_buffer_put(protected_buffer_t * b, void * d){
+  int done = 0;
+  int spun = 0;
 
   // Enter mutual exclusionss
-  pthread_mutex_lock(&(b->m)); //lock m
+  pthread_mutex_lock(&(COND(b)->m)); //lock m
   // Wait until there is an empty slot to put data in the unprotected
-  // circular buffer (circular_buffer_put).
-  while(circular_buffer_put(b->buffer, d)==0){
-    pthread_cond_wait(&(b->empty), &(b->m));
+  // circular buffer (circular_buffer_put), unless the buffer is closed.
+  while(!b->closed && ((done = circular_buffer_put(COND(b)->buffer, d)) == 0)){
+    if (protected_buffer_spin(b, cond_not_full, &spun, &(COND(b)->m))) continue;
+    cond_block(b, &(COND(b)->empty), &(COND(b)->n_waiting_producers), NULL);
   }
-  // Signal or broadcast that a full slot is available in the
-  // unprotected circular buffer (if needed)
-
-  pthread_cond_broadcast(&(b->full)); //releases threads waiting for an empty slot
+  // Signal that a full slot is available in the unprotected circular
+  // buffer (if needed)
+  if (done) cond_wakeup(b, &(COND(b)->full), COND(b)->n_waiting_consumers, 1);
 
-  circular_buffer_put(b->buffer, d);
-  print_task_activity ("put", d);
+  print_task_activity ("put", done ? d : NULL);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //release m
+  pthread_mutex_unlock(&(COND(b)->m)); //release m
 
+  return done;
 }
 
 // Extract an element from buffer. If the attempted operation is not
@@ -73,21 +152,18 @@ void * cond_protected_buffer_remove(protected_buffer_t * b){
   void * d;
 
   // Enter mutual exclusion
-  pthread_mutex_lock(&(b->m)); //lock m
-
-  // Signal or broadcast that an empty slot is available in the
-  // unprotected circular buffer (if needed)
+  pthread_mutex_lock(&(COND(b)->m)); //lock m
 
-  d = circular_buffer_get(b->buffer); //returns NULL if empty buffer and element otherwise
-  if (d != NULL) pthread_cond_broadcast(&(b->empty)); //releases other threads waiting for empty slot if remove succed
+  d = circular_buffer_get(COND(b)->buffer); //returns NULL if empty buffer and element otherwise
 
-  // Signal or broadcast that an empty slot is available in the
-  // unprotected circular buffer (if needed)
+  // Signal that an empty slot is available in the unprotected
+  // circular buffer (if needed)
+  if (d != NULL) cond_wakeup(b, &(COND(b)->empty), COND(b)->n_waiting_producers, 1);
 
   print_task_activity ("remove", d);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //releases m
+  pthread_mutex_unlock(&(COND(b)->m)); //releases m
   return d;
 }
 
@@ -97,22 +173,21 @@ int cond_protected_buffer_add(protected_buffer_t * b, void * d){
   int done;
 
   // Enter mutual exclusion
-  pthread_mutex_lock(&(b->m)); //lock m
-
-  // Signal or broadcast that a full slot is available in the
-  // unprotected circular buffer (if needed)
+  pthread_mutex_lock(&(COND(b)->m)); //lock m
 
-  done = circular_buffer_put(b->buffer, d); //0 if buffer full otherwise 1
+  done = !b->closed && circular_buffer_put(COND(b)->buffer, d); //0 if buffer full or closed otherwise 1
 
   if (!done) d=NULL; //if d is never add to buffer it is set to null to be printed out as null value
 
-  pthread_cond_broadcast(&(b->full)); //releases threads waiting for full slot in both cases (0 or 1)
+  // Signal that a full slot is available in the unprotected circular
+  // buffer (if needed)
+  if (done) cond_wakeup(b, &(COND(b)->full), COND(b)->n_waiting_consumers, 1);
 
   print_task_activity ("add", d);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //release m
-  
+  pthread_mutex_unlock(&(COND(b)->m)); //release m
+
   return done;
 }
 
@@ -123,28 +198,33 @@ int cond_protected_buffer_add(protected_buffer_t * b, void * d){
 void * cond_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
   void * d = NULL;
   int    rc = 0;
+  int    spun = 0;
 
   // Enter mutual exclusion
-  pthread_mutex_lock(&(b->m)); //lock m
-
-  // Wait until there is an empty slot to put data in the unprotected
-  // circular buffer (circular_buffer_put) but waits no longer than
-  // the given timeout.
+  pthread_mutex_lock(&(COND(b)->m)); //lock m
 
-  while ((d=circular_buffer_get(b->buffer))== NULL) {
-    rc = pthread_cond_timedwait(&(b->empty), &(b->m),abstime);
-    if (rc==ETIMEDOUT) {
-      break;}
+  // Wait until there is a full slot to get data from the unprotected
+  // circular buffer (circular_buffer_get) but waits no longer than
+  // the given timeout. Try once more after the timeout, the wakeup
+  // may have been consumed by this thread.
+  while (((d = circular_buffer_get(COND(b)->buffer)) == NULL) && (rc != ETIMEDOUT)) {
+    if (b->closed) {
+      d = PROTECTED_BUFFER_CLOSED;
+      break;
+    }
+    if (protected_buffer_spin(b, cond_not_empty, &spun, &(COND(b)->m))) continue;
+    rc = cond_block(b, &(COND(b)->full), &(COND(b)->n_waiting_consumers), abstime);
   }
 
-  // Signal or broadcast that an empty slot is available in the
-  // unprotected circular buffer (if needed)
-  if (rc != ETIMEDOUT) {pthread_cond_broadcast(&(b->empty));}
+  // Signal that an empty slot is available in the unprotected
+  // circular buffer (if needed)
+  if ((d != NULL) && (d != PROTECTED_BUFFER_CLOSED))
+    cond_wakeup(b, &(COND(b)->empty), COND(b)->n_waiting_producers, 1);
 
-  print_task_activity ("poll", d);
+  print_task_activity ("poll", (d == PROTECTED_BUFFER_CLOSED) ? NULL : d);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //release m
+  pthread_mutex_unlock(&(COND(b)->m)); //release m
   return d;
 }
 
@@ -155,27 +235,150 @@ void * cond_protected_buffer_poll(protected_buffer_t * b, struct timespec *absti
 int cond_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
   int rc = 0;
   int done = 0;
+  int spun = 0;
 
   // Enter mutual exclusion
-  pthread_mutex_lock(&(b->m)); //lock m
-
-  // Signal or broadcast that a full slot is available in the
-  // unprotected circular buffer (if needed) but waits no longer than
-  // the given timeout.
-  while ((done = circular_buffer_put(b->buffer,d))== 0) {
-    rc = pthread_cond_timedwait(&(b->full), &(b->m),abstime);
-    if (rc == ETIMEDOUT) {
-      break;}
+  pthread_mutex_lock(&(COND(b)->m)); //lock m
+
+  // Wait until there is an empty slot to put data in the unprotected
+  // circular buffer (circular_buffer_put) but waits no longer than
+  // the given timeout, unless the buffer is closed.
+  while (!b->closed && ((done = circular_buffer_put(COND(b)->buffer, d)) == 0) && (rc != ETIMEDOUT)) {
+    if (protected_buffer_spin(b, cond_not_full, &spun, &(COND(b)->m))) continue;
+    rc = cond_block(b, &(COND(b)->empty), &(COND(b)->n_waiting_producers), abstime);
   }
-  // Signal or broadcast that an empty slot is available in the
-  // unprotected circular buffer (if needed)
-  if (rc != ETIMEDOUT) {pthread_cond_broadcast(&(b->empty));} 
+
+  // Signal that a full slot is available in the unprotected circular
+  // buffer (if needed)
+  if (done) cond_wakeup(b, &(COND(b)->full), COND(b)->n_waiting_consumers, 1);
 
   if (!done) d = NULL; //d is printed out as null if never added to buffer
   print_task_activity ("offer", d);
 
   // Leave mutual exclusion
-  pthread_mutex_unlock(&(b->m)); //release m
+  pthread_mutex_unlock(&(COND(b)->m)); //release m
+
+  return done;
+}
 
+// Insert the n elements of d into buffer. If there is not enough
+// room, the method call blocks until there is. The elements are
+// inserted in runs, each one under a single lock acquisition and
+// followed by a single wakeup. Return the number of elements
+// inserted, n unless the buffer is closed.
+int cond_protected_buffer_put_all(protected_buffer_t * b, void ** d, int n){
+  int done = 0;
+  int run;
+  int spun = 0;
+
+  pthread_mutex_lock(&(COND(b)->m));
+  while (done < n) {
+    // Wait until there is at least one empty slot, then fill as many
+    // slots as possible.
+    while (!b->closed && (circular_buffer_size(COND(b)->buffer) == COND(b)->buffer->max_size))
+      if (!protected_buffer_spin(b, cond_not_full, &spun, &(COND(b)->m)))
+        cond_block(b, &(COND(b)->empty), &(COND(b)->n_waiting_producers), NULL);
+    if (b->closed) break;
+    run = circular_buffer_put_n(COND(b)->buffer, &d[done], n - done);
+    cond_wakeup(b, &(COND(b)->full), COND(b)->n_waiting_consumers, run);
+    done += run;
+  }
+  print_task_activity ("put_all", NULL);
+  pthread_mutex_unlock(&(COND(b)->m));
   return done;
 }
+
+// Insert the first elements of d, at most n, into buffer. Do not
+// block. The elements are inserted under a single lock acquisition
+// and followed by a single wakeup. Return the number of elements
+// inserted.
+int cond_protected_buffer_add_n(protected_buffer_t * b, void ** d, int n){
+  int done = 0;
+
+  pthread_mutex_lock(&(COND(b)->m));
+  if (!b->closed) done = circular_buffer_put_n(COND(b)->buffer, d, n);
+  if (done != 0) cond_wakeup(b, &(COND(b)->full), COND(b)->n_waiting_consumers, done);
+  print_task_activity ("add_n", NULL);
+  pthread_mutex_unlock(&(COND(b)->m));
+  return done;
+}
+
+// Extract at most max elements from buffer into out. Do not block.
+// Return the number of elements extracted.
+int cond_protected_buffer_drain_to(protected_buffer_t * b, void ** out, int max){
+  int done;
+
+  pthread_mutex_lock(&(COND(b)->m));
+  done = circular_buffer_get_n(COND(b)->buffer, out, max);
+  if (done != 0) cond_wakeup(b, &(COND(b)->empty), COND(b)->n_waiting_producers, done);
+  print_task_activity ("drain_to", NULL);
+  pthread_mutex_unlock(&(COND(b)->m));
+  return done;
+}
+
+// Extract at most max elements from buffer into out. If the buffer is
+// empty, the method call blocks until it is not, but waits no longer
+// than the given timeout. Return the number of elements extracted.
+int cond_protected_buffer_poll_n(protected_buffer_t * b, void ** out, int max,
+                                 struct timespec * abstime){
+  int done;
+  int rc = 0;
+  int spun = 0;
+
+  pthread_mutex_lock(&(COND(b)->m));
+  // Without abstime, do not block (see protected_buffer.h)
+  while ((abstime != NULL) && (circular_buffer_size(COND(b)->buffer) == 0) && !b->closed
+         && (rc != ETIMEDOUT))
+    if (!protected_buffer_spin(b, cond_not_empty, &spun, &(COND(b)->m)))
+      rc = cond_block(b, &(COND(b)->full), &(COND(b)->n_waiting_consumers), abstime);
+  done = circular_buffer_get_n(COND(b)->buffer, out, max);
+  if (done != 0) cond_wakeup(b, &(COND(b)->empty), COND(b)->n_waiting_producers, done);
+  print_task_activity ("poll_n", NULL);
+  pthread_mutex_unlock(&(COND(b)->m));
+  return done;
+}
+
+// Close buffer and wake up all the waiting threads at once.
+void cond_protected_buffer_close(protected_buffer_t * b){
+  pthread_mutex_lock(&(COND(b)->m));
+  __atomic_store_n(&(b->closed), 1, __ATOMIC_RELAXED);
+  pthread_cond_broadcast(&(COND(b)->full));
+  pthread_cond_broadcast(&(COND(b)->empty));
+  COND(b)->n_wakeups += COND(b)->n_waiting_consumers + COND(b)->n_waiting_producers;
+  pthread_mutex_unlock(&(COND(b)->m));
+}
+
+// Free buffer and its synchronisation components.
+void cond_protected_buffer_destroy(protected_buffer_t * b){
+  circular_buffer_destroy(COND(b)->buffer);
+  pthread_mutex_destroy(&(COND(b)->m));
+  pthread_cond_destroy(&(COND(b)->empty));
+  pthread_cond_destroy(&(COND(b)->full));
+  protected_buffer_free(b);
+}
+
+void cond_protected_buffer_wakeups(protected_buffer_t * b, long * n_wakeups,
+                                   long * n_wakeups_avoided){
+  pthread_mutex_lock(&(COND(b)->m));
+  *n_wakeups = COND(b)->n_wakeups;
+  *n_wakeups_avoided = COND(b)->n_wakeups_avoided;
+  pthread_mutex_unlock(&(COND(b)->m));
+}
+
+// Operations of this implementation, registered in protected_buffer.c
+const protected_buffer_ops_t cond_protected_buffer_ops = {
+  "cond",
+  cond_protected_buffer_init,
+  cond_protected_buffer_get,
+  cond_protected_buffer_put,
+  cond_protected_buffer_remove,
+  cond_protected_buffer_add,
+  cond_protected_buffer_poll,
+  cond_protected_buffer_offer,
+  cond_protected_buffer_put_all,
+  cond_protected_buffer_add_n,
+  cond_protected_buffer_drain_to,
+  cond_protected_buffer_poll_n,
+  cond_protected_buffer_close,
+  cond_protected_buffer_destroy
+};
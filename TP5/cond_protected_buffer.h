@@ -11,11 +11,13 @@ protected_buffer_t * cond_protected_buffer_init(int length);
 
 // Extract an element from buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
 void * cond_protected_buffer_get(protected_buffer_t * b);
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
-void cond_protected_buffer_put(protected_buffer_t * b, void * d);
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int cond_protected_buffer_put(protected_buffer_t * b, void * d);
 
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, return NULL. Otherwise, return the element.
@@ -28,7 +30,8 @@ int cond_protected_buffer_add(protected_buffer_t * b, void * d);
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, the method call blocks until it is, but
 // waits no longer than the given timeout. Return the element if
-// successful. Otherwise, return NULL.
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
 void * cond_protected_buffer_poll(protected_buffer_t * b, struct timespec * abstime);
 
 // Insert an element into buffer. If the attempted operation is not
@@ -36,4 +39,38 @@ void * cond_protected_buffer_poll(protected_buffer_t * b, struct timespec * abst
 // waits no longer than the given timeout. Return 0 if not
 // successful. Otherwise, return 1.
 int cond_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime);
+
+// Insert the n elements of d into buffer. If there is not enough
+// room, the method call blocks until there is. Return the number of
+// elements inserted, n unless the buffer is closed.
+int cond_protected_buffer_put_all(protected_buffer_t * b, void ** d, int n);
+
+// Insert the first elements of d, at most n, into buffer. Do not
+// block. Return the number of elements inserted.
+int cond_protected_buffer_add_n(protected_buffer_t * b, void ** d, int n);
+
+// Extract at most max elements from buffer into out. Do not block.
+// Return the number of elements extracted.
+int cond_protected_buffer_drain_to(protected_buffer_t * b, void ** out, int max);
+
+// Extract at most max elements from buffer into out. If the buffer is
+// empty, the method call blocks until it is not, but waits no longer
+// than the given timeout. Return the number of elements extracted.
+int cond_protected_buffer_poll_n(protected_buffer_t * b, void ** out, int max,
+                                 struct timespec * abstime);
+
+// Close buffer and wake up all the waiting threads.
+void cond_protected_buffer_close(protected_buffer_t * b);
+
+// Free buffer. No thread may use it anymore.
+void cond_protected_buffer_destroy(protected_buffer_t * b);
+
+// Store into n_wakeups the number of threads woken up so far, and into
+// n_wakeups_avoided the number of notifications skipped as nobody was
+// waiting.
+void cond_protected_buffer_wakeups(protected_buffer_t * b, long * n_wakeups,
+                                   long * n_wakeups_avoided);
+
+// Operations of this implementation, registered in protected_buffer.c
+extern const protected_buffer_ops_t cond_protected_buffer_ops;
 #endif
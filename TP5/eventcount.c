@@ -0,0 +1,72 @@
+#include <errno.h>
+#include <pthread.h>
+#include "eventcount.h"
+
+// Initialise the eventcount structure above.
+void eventcount_init(eventcount_t * ec) {
+  ec->epoch = 0;
+  ec->waiters = 0;
+  pthread_mutex_init(&(ec->m), NULL);
+  pthread_cond_init(&(ec->cond), NULL);
+}
+
+void eventcount_destroy(eventcount_t * ec) {
+  pthread_mutex_destroy(&(ec->m));
+  pthread_cond_destroy(&(ec->cond));
+}
+
+// Announce the calling thread as a waiter and return the current
+// epoch. The fence orders the announcement before the caller checks
+// its condition again, and pairs with the one in eventcount_signal.
+unsigned int eventcount_prepare_wait(eventcount_t * ec) {
+  __atomic_add_fetch(&(ec->waiters), 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  return __atomic_load_n(&(ec->epoch), __ATOMIC_RELAXED);
+}
+
+// Withdraw the announcement made by eventcount_prepare_wait.
+void eventcount_cancel_wait(eventcount_t * ec) {
+  __atomic_sub_fetch(&(ec->waiters), 1, __ATOMIC_RELAXED);
+}
+
+// Block until the epoch differs from key, but no longer than abstime
+// when it is not NULL.
+int eventcount_wait(eventcount_t * ec, unsigned int key, struct timespec * abstime) {
+  int rc = 0;
+
+  pthread_mutex_lock(&(ec->m));
+  while ((__atomic_load_n(&(ec->epoch), __ATOMIC_RELAXED) == key) && (rc != ETIMEDOUT)) {
+    if (abstime == NULL)
+      pthread_cond_wait(&(ec->cond), &(ec->m));
+    else
+      rc = pthread_cond_timedwait(&(ec->cond), &(ec->m), abstime);
+  }
+  pthread_mutex_unlock(&(ec->m));
+  eventcount_cancel_wait(ec);
+  return rc;
+}
+
+// Bump the epoch and wake up waiters when some are announced. The
+// fence orders the update of the caller's structure before reading
+// the number of waiters, and pairs with eventcount_prepare_wait.
+static void eventcount_signal(eventcount_t * ec, int all) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&(ec->waiters), __ATOMIC_RELAXED) == 0) return;
+  pthread_mutex_lock(&(ec->m));
+  __atomic_add_fetch(&(ec->epoch), 1, __ATOMIC_RELAXED);
+  if (all)
+    pthread_cond_broadcast(&(ec->cond));
+  else
+    pthread_cond_signal(&(ec->cond));
+  pthread_mutex_unlock(&(ec->m));
+}
+
+// Wake up one waiter, if any.
+void eventcount_notify(eventcount_t * ec) {
+  eventcount_signal(ec, 0);
+}
+
+// Wake up all waiters, if any.
+void eventcount_notify_all(eventcount_t * ec) {
+  eventcount_signal(ec, 1);
+}
@@ -1,7 +1,13 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sched.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 #include "executor.h"
+#include "futex.h"
 #include "utils.h"
 
 pthread_mutex_t mts0;
@@ -10,174 +16,950 @@ pthread_cond_t  cvts0;
 // Main for threads executing callables
 void * main_pool_thread (void * arg);
 
+// Main for the pool threads started before any submission
+static void * main_prestarted_pool_thread (void * arg);
+
+// Main for the timer thread of a scheduled executor
+static void * main_timer_thread (void * arg);
+
+// Remove the cancelled futures from the blocking queue
+static void queue_drop_cancelled (executor_t * executor);
+
+// Executor and deque of the current pool thread, if any, and seed of
+// its random choice of victims.
+static __thread executor_t * current_executor = NULL;
+static __thread int          current_deque = -1;
+static __thread unsigned int steal_seed;
+
 // Allocate and initialize executor. First, allocate and initialize a
 // thread pool. Second, allocate and initialize a blocking queue to
 // store pending callables.
 executor_t * executor_init (int core_pool_size,
 			    int max_pool_size,
 			    long keep_alive_time,
-			    int callable_array_size) {
+			    int callable_array_size,
+			    long futures_impl,
+			    pool_thread_attr_t * thread_attr) {
   executor_t * executor;
+  int          i;
   executor = (executor_t *) malloc (sizeof(executor_t));
 
   executor->keep_alive_time = keep_alive_time;
-  executor->thread_pool = thread_pool_init (core_pool_size, max_pool_size);
-  // Create a protected buffer for futures. Use the implementation
-  // based on cond variables (first parameter sem_impl set to false).
-  executor->futures = protected_buffer_init (0, callable_array_size);
+  executor->thread_pool = thread_pool_init (core_pool_size, max_pool_size, thread_attr);
+  // Create a protected buffer for futures. Use the requested
+  // implementation (COND_IMPL for the one based on cond variables).
+  executor->futures = protected_buffer_init (futures_impl, callable_array_size);
+  executor->queue_size = callable_array_size;
+  pthread_mutex_init(&(executor->sweep_m),NULL);
+
+  // Create a deque for each pool thread
+  executor->n_deques = max_pool_size;
+  executor->deques = (ws_deque_t **) malloc (max_pool_size * sizeof(ws_deque_t *));
+  executor->owned = (int *) malloc (max_pool_size * sizeof(int));
+  for (i = 0; i < max_pool_size; i++) {
+    executor->deques[i] = ws_deque_init (callable_array_size);
+    executor->owned[i] = 0;
+  }
+  executor->n_idle = 0;
+
+  pthread_mutex_init(&(executor->free_futures_m),NULL);
+  executor->free_futures = NULL;
+  executor->n_futures = 0;
+
+  executor->scheduled = 0;
+  executor->timers = NULL;
+  pthread_mutex_init(&(executor->timers_m),NULL);
+  pthread_cond_init(&(executor->timers_cond),NULL);
+  executor->timers_closed = 0;
+
+  executor->edf = 0;
+  executor->ready = NULL;
+  pthread_mutex_init(&(executor->ready_m),NULL);
+  pthread_cond_init(&(executor->ready_cond),NULL);
+
+  executor->rejection_policy   = REJECT_ABORT;
+  executor->block_timeout      = 0;
+  executor->n_aborted          = 0;
+  executor->n_caller_runs      = 0;
+  executor->n_discarded_newest = 0;
+  executor->n_discarded_oldest = 0;
+  executor->n_blocked          = 0;
+  executor->n_block_timeouts   = 0;
 
   return executor;
 }
 
-// Associate a thread from thread pool to callable. Then invoke
-// callable. Otherwise, store it in the blocking queue.
-future_t * submit_callable (executor_t * executor, callable_t * callable) {
-  future_t * future = (future_t *) malloc (sizeof(future_t));
+int executor_prestart_core_threads (executor_t * executor) {
+  int     n = executor->thread_pool->core_pool_size;
+  void ** args = (void **) malloc (n * sizeof(void *));
+  int     done;
+  int     i;
+
+  for (i = 0; i < n; i++) args[i] = executor;
+  done = pool_threads_create (executor->thread_pool, main_prestarted_pool_thread,
+                              args, n, 0);
+  free (args);
+  return done;
+}
+
+void executor_set_edf (executor_t * executor) {
+  // The heap grows as needed
+  executor->ready = timer_heap_init (64);
+  executor->edf = 1;
+}
+
+void executor_set_rejection_policy (executor_t * executor, int policy,
+                                    long block_timeout) {
+  executor->rejection_policy = policy;
+  executor->block_timeout    = block_timeout;
+}
+
+// Allocate and initialize executor, then its timers heap and its
+// timer thread.
+executor_t * scheduled_executor_init (int core_pool_size,
+                                      int max_pool_size,
+                                      long keep_alive_time,
+                                      int callable_array_size,
+                                      long futures_impl,
+                                      pool_thread_attr_t * thread_attr) {
+  executor_t * executor = executor_init (core_pool_size, max_pool_size,
+                                         keep_alive_time, callable_array_size,
+                                         futures_impl, thread_attr);
+
+  executor->scheduled = 1;
+  executor->timers = timer_heap_init (callable_array_size);
+  pthread_create(&(executor->timer_thread),NULL,main_timer_thread,executor);
+  return executor;
+}
+
+// Number of futures allocated at once when there is no free one
+#define FUTURES_CHUNK 64
+
+// Get n futures from the free futures of executor into futures. When
+// there are not enough, allocate chunks of futures and initialise
+// their synchronisation objects, used to block threads until the
+// result of the callable computation becames available.
+static void futures_alloc (executor_t * executor, future_t ** futures, int n) {
+  future_t * future;
+  int        i;
+  int        j;
+
+  pthread_mutex_lock(&(executor->free_futures_m));
+  for (j = 0; j < n; j++) {
+    if (executor->free_futures == NULL) {
+      future = (future_t *) malloc (FUTURES_CHUNK * sizeof(future_t));
+      for (i = 0; i < FUTURES_CHUNK; i++) {
+        future[i].executor = executor;
+        future[i].next = (i + 1 < FUTURES_CHUNK) ? &future[i + 1] : NULL;
+      }
+      executor->free_futures = future;
+      executor->n_futures += FUTURES_CHUNK;
+    }
+    futures[j] = executor->free_futures;
+    executor->free_futures = futures[j]->next;
+  }
+  pthread_mutex_unlock(&(executor->free_futures_m));
+}
+
+// Release a reference on future. Once there is none, give the future
+// back to its executor.
+static void future_unref (future_t * future, int n) {
+  executor_t * executor = future->executor;
+
+  if (__atomic_sub_fetch(&(future->refs), n, __ATOMIC_ACQ_REL) != 0) return;
+  pthread_mutex_lock(&(executor->free_futures_m));
+  future->next = executor->free_futures;
+  executor->free_futures = future;
+  pthread_mutex_unlock(&(executor->free_futures_m));
+}
+
+// Release the reference of the submitter on future
+void future_release (future_t * future) {
+  future_unref (future, 1);
+}
+
+// Move future from the pending state to state, unless it left the
+// pending state meanwhile. Without waiters, this is a single compare
+// and swap. Otherwise, clear the waiters flag as well and wake them
+// up. Return whether the state was set.
+static int future_set_state (future_t * future, unsigned int state) {
+  unsigned int old = FUTURE_STATE_PENDING;
+
+  while (!__atomic_compare_exchange_n(&(future->state), &old, state, 0,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    if ((old & ~FUTURE_STATE_WAITERS) != FUTURE_STATE_PENDING) return 0;
+  if (old & FUTURE_STATE_WAITERS) futex_wake (&(future->state), INT_MAX);
+  return 1;
+}
+
+// Complete future with result, unless it was cancelled meanwhile.
+// The result is set before the state, so that a thread reading the
+// state reads the result as well. Then, release the reference of the
+// executor on future.
+static void future_complete (future_t * future, void * result) {
+  future->result = result;
+  future_set_state (future, FUTURE_STATE_COMPLETED);
+  future_unref (future, 1);
+}
+
+// Return the result of future in state, FUTURE_NOT_READY when pending
+static void * future_result (future_t * future, unsigned int state) {
+  if (state == FUTURE_STATE_COMPLETED) return future->result;
+  if (state == FUTURE_STATE_CANCELLED) return FUTURE_CANCELLED;
+  return FUTURE_NOT_READY;
+}
+
+// Return whether future was cancelled
+static int future_cancelled (future_t * future) {
+  return __atomic_load_n(&(future->state), __ATOMIC_ACQUIRE) == FUTURE_STATE_CANCELLED;
+}
+
+// Once cancelled, a queued future gives its slot back at once rather
+// than when a pool thread dequeues it.
+int future_cancel (future_t * future) {
+  if (!future_set_state (future, FUTURE_STATE_CANCELLED)) return 0;
+  queue_drop_cancelled (future->executor);
+  return 1;
+}
+
+// The blocking queue, the deques and the heaps hold entries. An entry
+// is a future, or a callable executed without future
+// (execute_callable) tagged by its lowest bit.
+#define CALLABLE_TAG ((uintptr_t) 1)
+
+static void * callable_entry (callable_t * callable) {
+  return (void *) ((uintptr_t) callable | CALLABLE_TAG);
+}
 
-  callable->executor = executor;
-  future->callable  = callable;
-  future->completed = 0;
+// Return the future of entry, NULL for a callable without future
+static future_t * entry_future (void * entry) {
+  if ((uintptr_t) entry & CALLABLE_TAG) return NULL;
+  return (future_t *) entry;
+}
+
+static callable_t * entry_callable (void * entry) {
+  if ((uintptr_t) entry & CALLABLE_TAG)
+    return (callable_t *) ((uintptr_t) entry & ~CALLABLE_TAG);
+  return ((future_t *) entry)->callable;
+}
+
+// Return whether the future of entry was cancelled
+static int entry_cancelled (void * entry) {
+  future_t * future = entry_future (entry);
+
+  return (future != NULL) && future_cancelled (future);
+}
+
+// Complete the future of entry, if any, with result
+static void entry_complete (void * entry, void * result) {
+  future_t * future = entry_future (entry);
 
-  // Future must include synchronisation objects to block threads
-  // until the result of the callable computation becames available.
-  
-  pthread_mutex_init(&(future->m),NULL); //init m of future
-  pthread_cond_init(&(future->cond_var),NULL); //init condition variable of future
+  if (future != NULL) future_complete (future, result);
+}
 
-  // Try to create a thread, but do not force to exceed core_pool_size
+// Dispatch the n entries to the pool threads, as many as possible.
+// Each step below handles as many of the remaining entries as
+// possible, with a single lock acquisition and a single wakeup.
+// Return the number of entries dispatched, the first ones.
+static int dispatch_entries (executor_t * executor, void ** entries, int n) {
+  void * entry;
+  int    done = 0;
+  int    pushed = 0;
+  int    queued;
+  int    i;
+
+  // Try to create threads, but do not force to exceed core_pool_size
   // (last parameter set to false).
-  if (pool_thread_create (executor->thread_pool, main_pool_thread, future, 0))
-    return future;
+  done += pool_threads_create (executor->thread_pool, main_pool_thread,
+                               &entries[done], n - done, 0);
+
+  // From a callable, push the remaining ones on the deque of the
+  // current pool thread. When pool threads are idle, they wait on the
+  // blocking queue, use it instead to wake them up.
+  if ((current_executor == executor) && !executor->edf &&
+      (__atomic_load_n(&(executor->n_idle), __ATOMIC_SEQ_CST) == 0)) {
+    while ((done + pushed < n) &&
+           ws_deque_push (executor->deques[current_deque], entries[done + pushed]))
+      pushed++;
+    done += pushed;
+
+    // A pool thread may have become idle meanwhile. It is counted in
+    // n_idle before it tries to steal a last time: either it sees the
+    // entries pushed, or they are seen idle here. Then, move them to
+    // the blocking queue to wake it up.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (pushed && (__atomic_load_n(&(executor->n_idle), __ATOMIC_SEQ_CST) != 0))
+      while ((pushed-- > 0) &&
+             ((entry = ws_deque_take (executor->deques[current_deque])) != NULL))
+        if (!protected_buffer_add (executor->futures, entry)) {
+          ws_deque_push (executor->deques[current_deque], entry);
+          break;
+        }
+  }
+
+  // When there are already enough created threads, queue the
+  // callables in the blocking queue. With EDF, the entries queued are
+  // tokens, insert the entries in the ready heap before a pool thread
+  // gets a token and pops the heap. When no pool thread could be
+  // created at all, nothing would run them: leave them to rejection.
+  if (get_size (executor->thread_pool) != 0) {
+    if (executor->edf) {
+      pthread_mutex_lock(&(executor->ready_m));
+      queued = protected_buffer_add_n (executor->futures, &entries[done], n - done);
+      for (i = done; i < done + queued; i++)
+        timer_heap_insert (executor->ready, &(entry_callable (entries[i])->deadline_time),
+                           entries[i]);
+      pthread_mutex_unlock(&(executor->ready_m));
+      done += queued;
+    } else
+      done += protected_buffer_add_n (executor->futures, &entries[done], n - done);
+  }
 
-  // When there are already enough created threads, queue the callable
-  // in the blocking queue.
+  // When the queue is full, try to create threads, but allow to
+  // exceed core_pool_size (last parameter set to true). Otherwise,
+  // the callables are rejected.
+  done += pool_threads_create (executor->thread_pool, main_pool_thread,
+                               &entries[done], n - done, 1);
+  return done;
+}
 
-  if(protected_buffer_add(executor->futures, future) == 1)
-    return future; //if callable could be queued (=1) future is directly returned else other functions are being tried
+// Compute the absolute deadline of callable from its release. Without
+// deadline, use the latest time, so that EDF queues it last.
+static void callable_set_deadline (callable_t * callable) {
+  long deadline = (callable->deadline != 0) ? callable->deadline : callable->period;
 
-  // When the queue is full, pop the first future from the queue and
-  // push the current one.
-  future_t * first = protected_buffer_remove(executor->futures);
-  if (first != NULL) {
-    protected_buffer_add(executor->futures, future); // we add the curent callable
-    future = first; // attribute popped collable to current thread
+  if (deadline == 0) {
+    callable->deadline_time.tv_sec  = LONG_MAX;
+    callable->deadline_time.tv_nsec = 0;
+    return;
   }
+  callable->deadline_time = callable->release;
+  add_millis_to_timespec (&(callable->deadline_time), deadline);
+}
 
-  // Try to create a thread, but allow to exceed core_pool_size (last
-  // parameter set to true).
-  pool_thread_create (executor->thread_pool, main_pool_thread, future, 1); //creates thread with last param true to allows thread to be created if pool full
-  return future;
+// Update the statistics of callable, as its execution
+// completes now
+static void callable_check_deadline (callable_t * callable) {
+  struct timespec ts_now;
+  struct timeval  tv_now;
+  long            lateness;
+
+  if ((callable->deadline == 0) && (callable->period == 0)) return;
+  gettimeofday (&tv_now, NULL);
+  TIMEVAL_TO_TIMESPEC (&tv_now, &ts_now);
+  if (!timespec_before (&(callable->deadline_time), &ts_now)) return;
+  lateness = (ts_now.tv_sec - callable->deadline_time.tv_sec) * 1000
+    + (ts_now.tv_nsec - callable->deadline_time.tv_nsec) / 1000000;
+  callable->n_missed++;
+  if (lateness > callable->max_lateness) callable->max_lateness = lateness;
 }
 
-// Get result from callable execution. Block if not available.
-void * get_callable_result (future_t * future) {
-  void * result;
+// Compute into release the release following release of periodic
+// callable, according to its periodic mode and overrun policy, as
+// its execution completes now.
+static void next_release (callable_t * callable, struct timespec * release) {
+  struct timespec ts_ahead;
+  struct timespec ts_now;
+  struct timeval  tv_now;
+
+  gettimeofday (&tv_now, NULL);
+  TIMEVAL_TO_TIMESPEC (&tv_now, &ts_now);
+
+  if (callable->periodic_mode == FIXED_DELAY) {
+    *release = ts_now;
+    add_millis_to_timespec (release, callable->period);
+    return;
+  }
 
-  // Protect against concurrent accesses. Block until the callable has
-  // completed.
+  // Fixed rate: the next release is period after release, unless the
+  // execution overruns and the missed releases are not all executed.
+  // Then, skip the ones released before now, or all but the last one.
+  add_millis_to_timespec (release, callable->period);
+  if (callable->overrun_policy == OVERRUN_RUN_ALL) return;
+  while (1) {
+    ts_ahead = *release;
+    add_millis_to_timespec (&ts_ahead, callable->period);
+    if (callable->overrun_policy == OVERRUN_SKIP) {
+      if (timespec_before (&ts_now, release)) break;
+    } else {
+      if (timespec_before (&ts_now, &ts_ahead)) break;
+    }
+    *release = ts_ahead;
+    callable->n_skipped++;
+  }
+}
 
-  pthread_mutex_lock(&(future->m)); //lock m
+// Insert the periodic entry into the timers heap at its next
+// release. Once the timer thread has terminated or the entry is
+// cancelled, complete the entry instead.
+static void timers_rearm (executor_t * executor, void * entry) {
+  pthread_mutex_lock(&(executor->timers_m));
+  if (executor->timers_closed || entry_cancelled (entry)) {
+    pthread_mutex_unlock(&(executor->timers_m));
+    entry_complete (entry, NULL);
+    return;
+  }
+  timer_heap_insert (executor->timers, &(entry_callable (entry)->release), entry);
+  pthread_cond_signal(&(executor->timers_cond));
+  pthread_mutex_unlock(&(executor->timers_m));
+}
 
-  // Unprotect against concurrent accesses
+// Skip the release of the periodic entry of a scheduled executor and
+// wait for the next one in the timers heap
+static void entry_skip_release (executor_t * executor, void * entry) {
+  callable_t * callable = entry_callable (entry);
 
-  while(future->completed == 0) 
-    pthread_cond_wait(&(future->cond_var),&(future->m));
+  add_millis_to_timespec (&(callable->release), callable->period);
+  callable_set_deadline (callable);
+  callable->n_skipped++;
+  timers_rearm (executor, entry);
+}
 
+// Wait for the earliest release in the timers heap and dispatch the
+// entry to the pool threads. A release that cannot be dispatched,
+// because the queue is full and no more thread can be created, is
+// skipped. A cancelled entry is completed at its release rather
+// than dispatched. Once the executor is shut down, complete the
+// entries left in the heap.
+static void * main_timer_thread (void * arg) {
+  executor_t    * executor = (executor_t *) arg;
+  timer_entry_t * first;
+  void          * entry;
+  struct timespec ts_release;
+  struct timespec ts_now;
+  struct timeval  tv_now;
+
+  pthread_mutex_lock(&(executor->timers_m));
+  while (!get_shutdown (executor->thread_pool)) {
+    first = timer_heap_first (executor->timers);
+    if (first == NULL) {
+      pthread_cond_wait(&(executor->timers_cond), &(executor->timers_m));
+      continue;
+    }
+    gettimeofday (&tv_now, NULL);
+    TIMEVAL_TO_TIMESPEC (&tv_now, &ts_now);
+    if (timespec_before (&ts_now, &(first->time))) {
+      // An earlier release may be inserted meanwhile
+      ts_release = first->time;
+      pthread_cond_timedwait(&(executor->timers_cond), &(executor->timers_m), &ts_release);
+      continue;
+    }
+    entry = timer_heap_remove_first (executor->timers);
+    pthread_mutex_unlock(&(executor->timers_m));
+    if (entry_cancelled (entry))
+      entry_complete (entry, NULL);
+    else if (dispatch_entries (executor, &entry, 1) == 0)
+      entry_skip_release (executor, entry);
+    pthread_mutex_lock(&(executor->timers_m));
+  }
+  executor->timers_closed = 1;
+  while ((entry = timer_heap_remove_first (executor->timers)) != NULL)
+    entry_complete (entry, NULL);
+  pthread_mutex_unlock(&(executor->timers_m));
+  return NULL;
+}
 
-  result = (void *) future->result;
-  // Do not bother to deallocate future
-  
-  pthread_mutex_unlock(&(future->m)); //unlock m
-  return result;
+// Execute the callable of entry, then complete entry
+static void entry_execute (executor_t * executor, void * entry) {
+  callable_t     * callable = entry_callable (entry);
+  void           * result;
+  struct timeval   tv_release;
+
+  if ((callable->period != 0) && executor->scheduled) {
+    // With a scheduled executor, execute a single release of a
+    // periodic callable. The timer thread dispatches the next one.
+    callable->main (callable->params);
+    callable_check_deadline (callable);
+    next_release (callable, &(callable->release));
+    callable_set_deadline (callable);
+    timers_rearm (executor, entry);
+    return;
+  }
+
+  // Periodic releases are computed from the first one
+  if (callable->period != 0) {
+    gettimeofday (&tv_release, NULL);
+    TIMEVAL_TO_TIMESPEC (&tv_release, &(callable->release));
+    callable_set_deadline (callable);
+  }
+
+  while (1) {
+    result = callable->main (callable->params);
+    callable_check_deadline (callable);
+
+    // When the callable is not periodic, leave first inner
+    // loop. The callable will not be executed again.
+    if (callable->period == 0) break;
+
+    // When the callable is periodic, wait for the next release time.
+
+    next_release (callable, &(callable->release));
+    callable_set_deadline (callable);
+    delay_until(&(callable->release)); //wait to updated absolute time
+
+    // Even when this callable is periodic, check whether the
+    // executor requested a shutdown or the future was cancelled
+    if (get_shutdown(executor->thread_pool) || entry_cancelled (entry)) break;
+
+  }
+
+  // As the callable is completed, resume the threads waiting for
+  // the result.
+  entry_complete (entry, result);
 }
 
-// Define main procedure to execute callables. The arg parameter
-// provides the first future object to be executed. Once it is
-// executed, the main procedure may pick a pending callable from the
-// executor blocking queue.
-void * main_pool_thread (void * arg) {
-  future_t           * future = (future_t *) arg;
-  callable_t         * callable;
-  executor_t         * executor;
-  struct timespec      ts_deadline;
-  struct timeval       tv_deadline;
+// Drop entry without executing it: cancel its future. A periodic
+// entry of a scheduled executor only skips its release.
+static void entry_discard (executor_t * executor, void * entry) {
+  future_t * future = entry_future (entry);
 
-  gettimeofday (&tv_deadline, NULL);
-  TIMEVAL_TO_TIMESPEC (&tv_deadline, &ts_deadline);
+  if ((entry_callable (entry)->period != 0) && executor->scheduled) {
+    entry_skip_release (executor, entry);
+    return;
+  }
+  if (future == NULL) return;
+  future_set_state (future, FUTURE_STATE_CANCELLED);
+  future_unref (future, 1);
+}
 
-  while (future != NULL) {
-    callable = (callable_t *) future->callable;
-    executor = (executor_t *) callable->executor;
+// With EDF, pop the earliest deadline entry from the ready heap for a
+// token got from the blocking queue. A token may be queued just
+// before its entry is inserted (queue_offer), wait on ready_cond for
+// it then. Called with ready_m held.
+static void * ready_remove_first (executor_t * executor) {
+  void * entry;
 
-    while (1) {
-      future->result = callable->main (callable->params);
+  while ((entry = timer_heap_remove_first (executor->ready)) == NULL)
+    pthread_cond_wait(&(executor->ready_cond), &(executor->ready_m));
+  return entry;
+}
 
-      // When the callable is not periodic, leave first inner
-      // loop. The callable will not be executed again.
-      if (callable->period == 0) {
+// Remove the entry at the head of the blocking queue, the oldest one,
+// or the earliest deadline one with EDF. Return NULL when it is empty.
+static void * queue_remove_head (executor_t * executor) {
+  void * entry;
+
+  if (executor->edf) pthread_mutex_lock(&(executor->ready_m));
+  entry = protected_buffer_remove (executor->futures);
+  if (entry == PROTECTED_BUFFER_CLOSED) entry = NULL;
+  if (executor->edf) {
+    if (entry != NULL) entry = ready_remove_first (executor);
+    pthread_mutex_unlock(&(executor->ready_m));
+  }
+  return entry;
+}
 
-        // As the callable is completed, the completed attribute and
-        // the synchronisation objects should be updated to resume
-        // threads waiting for the result.
+// Insert entry into the blocking queue, waiting for room no longer
+// than abstime. With EDF, ready_m cannot be held meanwhile, as the
+// pool threads holding a token wait for it. Insert the entry into
+// the ready heap once its token is queued.
+static int queue_offer (executor_t * executor, void * entry, struct timespec * abstime) {
+  int done = protected_buffer_offer (executor->futures, entry, abstime);
+
+  if (done && executor->edf) {
+    pthread_mutex_lock(&(executor->ready_m));
+    timer_heap_insert (executor->ready, &(entry_callable (entry)->deadline_time), entry);
+    pthread_cond_broadcast(&(executor->ready_cond));
+    pthread_mutex_unlock(&(executor->ready_m));
+  }
+  return done;
+}
 
-        pthread_cond_broadcast(&(future->cond_var)); //send broadcast to release thread blocked
-        future->completed = 1; //to get out of while loop
-        break;
-      }
+// Remove the cancelled futures from the blocking queue and release the
+// reference of the executor on them. The queue cannot remove an entry
+// from its middle: drain it without blocking and queue the other
+// entries again, in the same order. Submitters may take the room
+// meanwhile, dispatch the entries left over as a submission does,
+// then wait for room. With EDF, the queue holds tokens: remove the
+// cancelled entries from the ready heap, each with a token. Tokens
+// already got by pool threads are left to them, with as many
+// cancelled entries, dropped when popped.
+static void queue_drop_cancelled (executor_t * executor) {
+  void ** entries;
+  void ** tokens;
+  int     n;
+  int     kept = 0;
+  int     done;
+  int     i;
+
+  pthread_mutex_lock(&(executor->sweep_m));
+  if (executor->edf) {
+    pthread_mutex_lock(&(executor->ready_m));
+    entries = (void **) malloc ((executor->ready->length + 1) * sizeof(void *));
+    n = timer_heap_remove_each (executor->ready, entry_cancelled, entries);
+    tokens = (void **) malloc ((n + 1) * sizeof(void *));
+    done = protected_buffer_drain_to (executor->futures, tokens, n);
+    for (i = done; i < n; i++)
+      timer_heap_insert (executor->ready, &(entry_callable (entries[i])->deadline_time),
+                         entries[i]);
+    pthread_mutex_unlock(&(executor->ready_m));
+    for (i = 0; i < done; i++) future_unref (entry_future (entries[i]), 1);
+    free (tokens);
+
+  } else {
+    entries = (void **) malloc (executor->queue_size * sizeof(void *));
+    n = protected_buffer_drain_to (executor->futures, entries, executor->queue_size);
+    for (i = 0; i < n; i++)
+      if (entry_cancelled (entries[i]))
+        future_unref (entry_future (entries[i]), 1);
+      else
+        entries[kept++] = entries[i];
+    done = protected_buffer_add_n (executor->futures, entries, kept);
+    if (done < kept)
+      done += dispatch_entries (executor, &entries[done], kept - done);
+    for (; done < kept; done++)
+      if (!protected_buffer_put (executor->futures, entries[done]))
+        entry_discard (executor, entries[done]);
+  }
+  pthread_mutex_unlock(&(executor->sweep_m));
+  free (entries);
+}
 
-      // When the callable is periodic, wait for the next release time.
+// Apply the rejection policy of executor to the n entries rejected,
+// as the queue is full and no more thread can be created. Return the
+// number of entries handled by the policy, the first ones. The other
+// ones are aborted, errno tells why: ESHUTDOWN once the executor is
+// shut down, ETIMEDOUT when blocking timed out, EAGAIN otherwise.
+static int reject_entries (executor_t * executor, void ** entries, int n) {
+  struct timeval  tv_now;
+  struct timespec ts_timeout;
+  void          * oldest;
+  int             reason = EAGAIN;
+  int             done = 0;
+
+  if (n == 0) return 0;
+  if (get_shutdown (executor->thread_pool)) reason = ESHUTDOWN;
+
+  else if (executor->rejection_policy == REJECT_CALLER_RUNS) {
+    // A periodic callable of an executor not scheduled would never
+    // return to the caller, abort it.
+    while ((done < n) && ((entry_callable (entries[done])->period == 0) ||
+                          executor->scheduled))
+      entry_execute (executor, entries[done++]);
+    __atomic_add_fetch(&(executor->n_caller_runs), done, __ATOMIC_RELAXED);
+
+  } else if (executor->rejection_policy == REJECT_DISCARD_NEWEST) {
+    for (done = 0; done < n; done++)
+      entry_discard (executor, entries[done]);
+    __atomic_add_fetch(&(executor->n_discarded_newest), n, __ATOMIC_RELAXED);
+
+  } else if (executor->rejection_policy == REJECT_DISCARD_OLDEST) {
+    // Other submitters may take the room made, discard as many as
+    // needed.
+    while ((done < n) && ((oldest = queue_remove_head (executor)) != NULL)) {
+      entry_discard (executor, oldest);
+      __atomic_add_fetch(&(executor->n_discarded_oldest), 1, __ATOMIC_RELAXED);
+      done += dispatch_entries (executor, &entries[done], n - done);
+    }
+
+  } else if ((executor->rejection_policy == REJECT_BLOCK) &&
+             (get_size (executor->thread_pool) != 0)) {
+    // Without any pool thread, the queue would not make room
+    gettimeofday (&tv_now, NULL);
+    TIMEVAL_TO_TIMESPEC (&tv_now, &ts_timeout);
+    add_millis_to_timespec (&ts_timeout, executor->block_timeout);
+    __atomic_add_fetch(&(executor->n_blocked), n, __ATOMIC_RELAXED);
+    while ((done < n) && queue_offer (executor, entries[done], &ts_timeout))
+      done++;
+    if (done < n) {
+      reason = get_shutdown (executor->thread_pool) ? ESHUTDOWN : ETIMEDOUT;
+      if (reason == ETIMEDOUT)
+        __atomic_add_fetch(&(executor->n_block_timeouts), n - done, __ATOMIC_RELAXED);
+    }
+  }
 
-      add_millis_to_timespec(&ts_deadline, callable->period); //set next absolute time to wait to current + periode
-      delay_until(&ts_deadline); //wait to updated absolute time
-      
-      // Even when this callable is periodic, check whether the
-      // executor requested a shutdown
-      if (get_shutdown(executor->thread_pool)) break;
+  if (done < n) {
+    __atomic_add_fetch(&(executor->n_aborted), n - done, __ATOMIC_RELAXED);
+    errno = reason;
+  }
+  return done;
+}
 
+// Associate a thread from thread pool to callable. Then invoke
+// callable. Otherwise, store it in the blocking queue.
+future_t * submit_callable (executor_t * executor, callable_t * callable) {
+  future_t * future;
+
+  submit_callables (executor, callable, 1, &future);
+  return future;
+}
+
+// Prepare callable for its submission to executor. Its first release
+// is tv_now.
+static void callable_init (executor_t * executor, callable_t * callable,
+                           struct timeval * tv_now) {
+  callable->executor     = executor;
+  callable->n_missed     = 0;
+  callable->n_skipped    = 0;
+  callable->max_lateness = 0;
+  TIMEVAL_TO_TIMESPEC (tv_now, &(callable->release));
+  callable_set_deadline (callable);
+}
+
+// Submit the n callables at once. Their first release is now.
+int submit_callables (executor_t * executor, callable_t * callables, int n,
+                      future_t ** futures) {
+  struct timeval tv_now;
+  int            done;
+  int            i;
+
+  futures_alloc (executor, futures, n);
+  gettimeofday (&tv_now, NULL);
+  for (i = 0; i < n; i++) {
+    callable_init (executor, &callables[i], &tv_now);
+    futures[i]->callable  = &callables[i];
+    futures[i]->state     = FUTURE_STATE_PENDING;
+    futures[i]->result    = NULL;
+    // One reference for the submitter, one for the pool thread
+    futures[i]->refs      = 2;
+  }
+
+  done = dispatch_entries (executor, (void **) futures, n);
+  done += reject_entries (executor, (void **) &futures[done], n - done);
+  for (i = done; i < n; i++) {
+    future_unref (futures[i], 2);
+    futures[i] = NULL;
+  }
+  return done;
+}
+
+// Queue the callable itself, tagged, rather than a future. Its first
+// release is now.
+int execute_callable (executor_t * executor, callable_t * callable) {
+  struct timeval tv_now;
+  void         * entry = callable_entry (callable);
+
+  gettimeofday (&tv_now, NULL);
+  callable_init (executor, callable, &tv_now);
+  if (dispatch_entries (executor, &entry, 1) == 1) return 1;
+  return reject_entries (executor, &entry, 1);
+}
+
+// Wait until future leaves the pending state, but no longer than
+// abstime when it is not NULL. Register as a waiter by setting the
+// waiters flag before sleeping on the state word, so that the
+// completion wakes the thread up.
+static void * future_wait (future_t * future, const struct timespec * abstime) {
+  unsigned int state = __atomic_load_n(&(future->state), __ATOMIC_ACQUIRE);
+
+  while ((state & ~FUTURE_STATE_WAITERS) == FUTURE_STATE_PENDING) {
+    if ((state == FUTURE_STATE_PENDING) &&
+        !__atomic_compare_exchange_n(&(future->state), &state, FUTURE_STATE_WAITERS,
+                                     0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+      continue;
+    if (futex_wait (&(future->state), FUTURE_STATE_WAITERS, abstime) == ETIMEDOUT) {
+      state = __atomic_load_n(&(future->state), __ATOMIC_ACQUIRE);
+      break;
     }
+    state = __atomic_load_n(&(future->state), __ATOMIC_ACQUIRE);
+  }
+  return future_result (future, state);
+}
 
-    future = NULL;
-    if (executor->keep_alive_time == FOREVER) {
-      // If the executor does not deallocate pool threads after being
-      // inactive for a xhile, just wait for the next available
-      // callable / future.
-      future = (future_t *) protected_buffer_get(executor->futures);
-      // If there is no callable to handle, remove the current pool
-      // thread from the pool.
-      if ((future == NULL) && pool_thread_remove(executor->thread_pool))
-        break;
+// Get result from callable execution. Block if not available.
+void * get_callable_result (future_t * future) {
+  return future_wait (future, NULL);
+}
 
-    } else {
+// Get result from callable execution. Block until abstime, a
+// CLOCK_MONOTONIC time as futex_wait takes, if not available.
+void * get_callable_result_timed (future_t * future, const struct timespec * abstime) {
+  return future_wait (future, abstime);
+}
+
+// Get result from callable execution. Block no longer than timeout ms
+// if not available.
+void * get_callable_result_timeout (future_t * future, long timeout) {
+  struct timespec ts_timeout;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts_timeout);
+  add_millis_to_timespec (&ts_timeout, timeout);
+  return future_wait (future, &ts_timeout);
+}
+
+// Get result from callable execution without blocking
+void * future_poll (future_t * future) {
+  return future_result (future, __atomic_load_n(&(future->state), __ATOMIC_ACQUIRE));
+}
+
+// Own one of the deques of executor for the current pool thread.
+// There are max_pool_size deques, but a terminating pool thread may
+// release its deque just after leaving the pool. Then, retry.
+static void own_deque (executor_t * executor) {
+  int i;
+
+  current_executor = executor;
+  steal_seed = (unsigned int) pthread_self();
+  while (1) {
+    for (i = 0; i < executor->n_deques; i++)
+      if (__atomic_exchange_n(&(executor->owned[i]), 1, __ATOMIC_ACQ_REL) == 0) {
+        current_deque = i;
+        return;
+      }
+    sched_yield ();
+  }
+}
+
+// Release the deque of the current pool thread. The deque is empty,
+// only its owner pushes callables and it has taken them all.
+static void release_deque (executor_t * executor) {
+  __atomic_store_n(&(executor->owned[current_deque]), 0, __ATOMIC_RELEASE);
+  current_executor = NULL;
+  current_deque = -1;
+}
+
+// Steal an entry from the deque of another pool thread, trying each
+// deque once from a random one.
+static void * steal_entry (executor_t * executor) {
+  void     * entry;
+  int        first = rand_r (&steal_seed) % executor->n_deques;
+  int        i;
+
+  for (i = 0; i < executor->n_deques; i++) {
+    int victim = (first + i) % executor->n_deques;
+    if (victim == current_deque) continue;
+    entry = ws_deque_steal (executor->deques[victim]);
+    if (entry != NULL) return entry;
+  }
+  return NULL;
+}
 
-      // If the executor is configured to release a thread when it is
-      // idle for keep_alive_time milliseconds, try to get a new
-      // callable / future during at most keep_alive_time ms.
+// With EDF, return the entry with the earliest deadline for a token
+// got from the blocking queue. Otherwise, the token is the entry.
+static void * ready_entry (executor_t * executor, void * token) {
+  void * entry;
+
+  if (!executor->edf || (token == NULL) || (token == PROTECTED_BUFFER_CLOSED))
+    return token;
+  pthread_mutex_lock(&(executor->ready_m));
+  entry = ready_remove_first (executor);
+  pthread_mutex_unlock(&(executor->ready_m));
+  return entry;
+}
+
+// Get the next entry to execute. First, take the last one pushed on
+// the deque of the current pool thread. Second, remove one from the
+// blocking queue. Third, steal one from another pool thread. If there
+// is none, wait on the blocking queue, forever or during at most
+// keep_alive_time ms. Return NULL on timeout and
+// PROTECTED_BUFFER_CLOSED once the executor is shut down.
+static void * next_entry (executor_t * executor) {
+  void * entry;
+
+  entry = ws_deque_take (executor->deques[current_deque]);
+  if (entry != NULL) return entry;
+  entry = ready_entry (executor, protected_buffer_remove (executor->futures));
+  if (entry != NULL) return entry;
+  entry = steal_entry (executor);
+  if (entry != NULL) return entry;
+
+  // Be counted idle before stealing a last time, so that a submitter
+  // pushing on its deque meanwhile wakes this thread up (see
+  // dispatch_entries).
+  __atomic_add_fetch(&(executor->n_idle), 1, __ATOMIC_SEQ_CST);
+  entry = steal_entry (executor);
+  if (entry != NULL) {
+    __atomic_sub_fetch(&(executor->n_idle), 1, __ATOMIC_SEQ_CST);
+    return entry;
+  }
+  if (executor->keep_alive_time == FOREVER) {
+    // If the executor does not deallocate pool threads after being
+    // inactive for a xhile, just wait for the next available
+    // callable / future.
+    entry = protected_buffer_get(executor->futures);
+
+  } else {
+
+    // If the executor is configured to release a thread when it is
+    // idle for keep_alive_time milliseconds, try to get a new
+    // callable / future during at most keep_alive_time ms.
 
-      struct timespec      new_ts; //redefine timespec timeval for scope time
-      struct timeval       new_tv;
+    struct timespec      new_ts; //redefine timespec timeval for scope time
+    struct timeval       new_tv;
 
-      gettimeofday (&new_tv, NULL);
+    gettimeofday (&new_tv, NULL);
 
-      TIMEVAL_TO_TIMESPEC (&new_tv, &new_ts); //convert times
-      add_millis_to_timespec (&new_ts, executor->keep_alive_time); //keep alive time added to current time
-      future = (future_t *) protected_buffer_poll(executor->futures, &new_ts); //keep alive time in protected_buffer_poll
+    TIMEVAL_TO_TIMESPEC (&new_tv, &new_ts); //convert times
+    add_millis_to_timespec (&new_ts, executor->keep_alive_time); //keep alive time added to current time
+    entry = protected_buffer_poll(executor->futures, &new_ts); //keep alive time in protected_buffer_poll
+  }
+  __atomic_sub_fetch(&(executor->n_idle), 1, __ATOMIC_SEQ_CST);
+  return ready_entry (executor, entry);
+}
+
+// Define main procedure to execute callables, from entry, or from
+// the next pending one when NULL. Once it is executed, the main
+// procedure may pick a pending callable from its own deque, from the
+// executor blocking queue or from the deque of another pool thread.
+static void * pool_thread_run (executor_t * executor, void * entry) {
+  own_deque (executor);
+
+  while (1) {
+    while (entry == NULL) {
+      // Without an entry to execute, get the next one
+      entry = next_entry (executor);
+
+      // Once the queue is closed and empty, the executor is shut
+      // down. Remove the current pool thread from the pool.
+      if (entry == PROTECTED_BUFFER_CLOSED) {
+        release_deque (executor);
+        pool_thread_remove (executor->thread_pool);
+        return NULL;
+      }
 
       // If there is no callable to handle, remove the current pool
-      // thread from the pool. And then, complete.
-      if ((future == NULL) && pool_thread_remove (executor->thread_pool))
-        break;
+      // thread from the pool, unless it is needed to keep
+      // core_pool_size threads. And then, complete.
+      if ((entry == NULL) && pool_thread_remove (executor->thread_pool)) {
+        release_deque (executor);
+        return NULL;
+      }
+    }
 
+    // A cancelled future is dropped, its callable is not executed
+    if (entry_cancelled (entry)) {
+      future_unref (entry_future (entry), 1);
+      entry = NULL;
+      continue;
     }
+
+    entry_execute (executor, entry);
+    entry = NULL;
   }
   return NULL;
 }
 
-// Wait for pool threads to be completed
+// The arg parameter provides the first entry to be executed, a future
+// or a tagged callable
+void * main_pool_thread (void * arg) {
+  return pool_thread_run (entry_callable (arg)->executor, arg);
+}
+
+// The arg parameter provides the executor. Wait for a pending
+// callable first.
+static void * main_prestarted_pool_thread (void * arg) {
+  return pool_thread_run ((executor_t *) arg, NULL);
+}
+
+// Stop the timer thread, close the blocking queue and wait for pool
+// threads to be completed
 void executor_shutdown (executor_t * executor) {
   thread_pool_t * thread_pool = executor->thread_pool;
   thread_pool_shutdown(thread_pool);
 
-  // Fill the queue of null futures to unblock potential threads
+  // Wake up the timer thread, it completes the periodic callables
+  // waiting for their next release.
+  if (executor->scheduled) {
+    pthread_mutex_lock(&(executor->timers_m));
+    pthread_cond_signal(&(executor->timers_cond));
+    pthread_mutex_unlock(&(executor->timers_m));
+    pthread_join(executor->timer_thread, NULL);
+  }
+
+  // Close the queue of futures to unblock the pool threads waiting
+  // for a callable. Once the queue is empty, they remove themselves
+  // from the pool.
+  protected_buffer_close(executor->futures);
   wait_thread_pool_empty(executor->thread_pool);
   printf ("%06ld [executor_shutdown]\n", relative_clock());
 }
\ No newline at end of file
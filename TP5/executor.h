@@ -5,48 +5,239 @@
 
 #include "thread_pool.h"
 #include "protected_buffer.h"
+#include "ws_deque.h"
+#include "timer_heap.h"
 
 #define FOREVER -1
 
+// Result of a cancelled future
+#define FUTURE_CANCELLED ((void *) -2)
+
+// Returned instead of the result when it is not available yet
+#define FUTURE_NOT_READY ((void *) -3)
+
+// States of a future. The state leaves FUTURE_STATE_PENDING only once,
+// after the result is set. While pending, FUTURE_STATE_WAITERS is set
+// once a thread sleeps on the state word.
+#define FUTURE_STATE_PENDING   0
+#define FUTURE_STATE_COMPLETED 1
+#define FUTURE_STATE_CANCELLED 2
+#define FUTURE_STATE_WAITERS   4
+
+// Rejection policies, applied to a submission once the queue is full
+// and no more thread can be created
+#define REJECT_ABORT          0 //reject it, errno tells why
+#define REJECT_CALLER_RUNS    1 //execute it in the submitting thread
+#define REJECT_DISCARD_NEWEST 2 //cancel it
+#define REJECT_DISCARD_OLDEST 3 //cancel the head of the queue, queue it
+#define REJECT_BLOCK          4 //wait for room in the queue, then abort
+
 struct _executor_t;
 
+// Periodic modes. With FIXED_RATE, the releases are every period from
+// the first one. With FIXED_DELAY, a release is period after the
+// previous execution completes.
+#define FIXED_RATE  0
+#define FIXED_DELAY 1
+
+// Overrun policies of a FIXED_RATE callable, when an execution
+// completes after one or more of the next releases
+#define OVERRUN_RUN_ALL  0 //execute the missed releases back to back
+#define OVERRUN_SKIP     1 //skip them, wait for the next release to come
+#define OVERRUN_COALESCE 2 //execute them once, at once
+
+// The deadline of an execution is deadline ms after its release. A
+// release of a periodic callable is the submission or its previous
+// release, a release of another callable is its submission. When
+// deadline is 0, the deadline of a release of a periodic callable is
+// its next release (release + period), and another callable has no
+// deadline. The statistics are reset on submission. The release and
+// the deadline are the ones of the current release.
 typedef struct {
   void               * params;
   main_func_t          main;
   long                 period;
+  long                 deadline; //relative deadline in ms
+  int                  periodic_mode; //FIXED_RATE or FIXED_DELAY
+  int                  overrun_policy; //OVERRUN_RUN_ALL, ...
   struct _executor_t * executor;
+  long                 n_missed; //executions completed after their deadline
+  long                 n_skipped; //releases not executed
+  long                 max_lateness; //ms, 0 when no deadline is missed
+  struct timespec      release; //release time
+  struct timespec      deadline_time; //absolute deadline of the release
 } callable_t;
 
-typedef struct {
-  pthread_mutex_t m; //add mutex
-  pthread_cond_t  cond_var; //add condition variable
-  int             completed;
-  callable_t    * callable;
-  void          * result;
+// Futures are allocated by chunks and recycled by their executor.
+// The submitter and the pool thread executing the callable each hold
+// a reference, the future is recycled once both have released it.
+// There is no mutex: the state word is changed atomically, and the
+// threads waiting for the result sleep on it (futex).
+typedef struct _future_t {
+  unsigned int         state; //FUTURE_STATE_PENDING, ...
+  callable_t         * callable;
+  void               * result;
+  struct _executor_t * executor; //executor recycling the future
+  int                  refs; //references held on the future
+  struct _future_t   * next; //next free future
 } future_t;
 
+// Each pool thread owns a work-stealing deque for the callables
+// submitted by the callables it executes. The callables submitted
+// from outside the pool go through the futures blocking queue. Idle
+// pool threads steal from the deques of the others. The queues hold
+// futures, and callables executed without future.
 typedef struct _executor_t {
   thread_pool_t      * thread_pool;
   long                 keep_alive_time;
-  protected_buffer_t * futures;
+  protected_buffer_t * futures; //global queue, submissions from outside the pool
+  int                  queue_size; //capacity of futures
+  pthread_mutex_t      sweep_m; //one sweep of the cancelled futures queued at a time
+  ws_deque_t        ** deques; //one per pool thread, max_pool_size
+  int                * owned; //whether a pool thread owns the deque
+  int                  n_deques;
+  int                  n_idle; //pool threads blocked on futures
+  pthread_mutex_t      free_futures_m;
+  future_t           * free_futures; //recycled futures
+  long                 n_futures; //futures allocated
+  // Scheduled executor only. The periodic callables wait for their
+  // next release in the timers heap, served by the timer thread.
+  int                  scheduled;
+  pthread_t            timer_thread;
+  pthread_mutex_t      timers_m;
+  pthread_cond_t       timers_cond;
+  timer_heap_t       * timers; //periodic callables keyed on their next release
+  int                  timers_closed; //timer thread terminated
+  // EDF executor only. The callables queued are kept in the ready
+  // heap keyed on their deadline. The blocking queue holds as many
+  // tokens, a pool thread getting one pops the earliest deadline one.
+  int                  edf;
+  pthread_mutex_t      ready_m;
+  pthread_cond_t       ready_cond; //a token was queued before its entry
+  timer_heap_t       * ready;
+  // Rejection policy and its counters
+  int                  rejection_policy; //REJECT_ABORT, ...
+  long                 block_timeout; //ms, REJECT_BLOCK only
+  long                 n_aborted; //submissions rejected
+  long                 n_caller_runs; //executed by their submitter
+  long                 n_discarded_newest; //submissions cancelled
+  long                 n_discarded_oldest; //queued callables cancelled
+  long                 n_blocked; //submissions waiting for room
+  long                 n_block_timeouts; //rejected as the wait timed out
 } executor_t;
 
 // Allocate and initialize executor. Allocate and initialize a thread
 // pool. Allocate and initialize a blocking queue to store unhandled
-// callables.
-executor_t * executor_init(int  core_pool_size,
-                           int  max_pool_size,
-                           long keep_alive_time,
-                           int  callable_array_size);
+// callables, using the protected buffer implementation futures_impl
+// (COND_IMPL, MPMC_IMPL, ... see protected_buffer.h). The queue is
+// shared by all submitters and pool threads, SPSC_IMPL does not fit.
+// Allocate one deque of callable_array_size callables per pool
+// thread. The pool threads are created with attributes thread_attr,
+// the default ones when NULL (see thread_pool.h).
+executor_t * executor_init(int                  core_pool_size,
+                           int                  max_pool_size,
+                           long                 keep_alive_time,
+                           int                  callable_array_size,
+                           long                 futures_impl,
+                           pool_thread_attr_t * thread_attr);
+
+// Allocate and initialize executor as executor_init does, plus a
+// timer thread. A periodic callable does not keep a pool thread
+// between its releases. Once executed, it waits for its next release
+// in a timer heap. The timer thread dispatches each release to the
+// pool threads as a submission does.
+executor_t * scheduled_executor_init(int                  core_pool_size,
+                                     int                  max_pool_size,
+                                     long                 keep_alive_time,
+                                     int                  callable_array_size,
+                                     long                 futures_impl,
+                                     pool_thread_attr_t * thread_attr);
+
+// Start the core pool threads at once rather than on the first
+// submissions, so that they wait for the callables in the blocking
+// queue. Return the number of threads started.
+int executor_prestart_core_threads(executor_t * executor);
+
+// Order the callables waiting in the blocking queue by earliest
+// deadline first rather than by submission. The callables submitted
+// from a callable go through the blocking queue as well, as the
+// deques are not ordered. Call before submitting callables.
+void executor_set_edf(executor_t * executor);
+
+// Set the rejection policy of executor, REJECT_ABORT by default. With
+// REJECT_BLOCK, a submission waits no longer than block_timeout ms.
+// With REJECT_CALLER_RUNS, a periodic callable is aborted unless the
+// executor is scheduled. With REJECT_DISCARD_NEWEST and
+// REJECT_DISCARD_OLDEST, the future of the callable discarded is
+// cancelled. With a scheduled executor, a periodic callable discarded
+// only skips its release. With EDF, the head of the queue is the
+// earliest deadline callable.
+void executor_set_rejection_policy(executor_t * executor,
+                                   int          policy,
+                                   long         block_timeout);
 
 // Associate a thread from thread pool to callable. Then invoke
-// callable. Otherwise, store it in the blocking queue.
+// callable. Otherwise, store it in the blocking queue. When called
+// from a callable, push it on the deque of the current pool thread
+// instead, unless some pool threads are idle. When the queue is full
+// and no more thread can be created, apply the rejection policy.
+// Return NULL when the callable is aborted, with errno set to
+// ESHUTDOWN once executor is shut down, ETIMEDOUT when REJECT_BLOCK
+// timed out, EAGAIN otherwise.
 future_t * submit_callable(executor_t * executor,
                            callable_t * callable);
 
-// Get result from callable execution. Block if not available.
+// Submit the n callables of the callables array as submit_callable
+// does, but with a few lock acquisitions for the whole batch. Store
+// their futures into futures, NULL for the rejected ones, which are
+// the last ones. Return the number of callables submitted.
+int submit_callables(executor_t * executor,
+                     callable_t * callables,
+                     int          n,
+                     future_t  ** futures);
+
+// Execute callable as submit_callable does, but without future: there
+// is no result to get. Return 0 when the callable is aborted, with
+// errno set as submit_callable does, 1 otherwise.
+int execute_callable(executor_t * executor,
+                     callable_t * callable);
+
+// Get result from callable execution. Block if not available. Return
+// FUTURE_CANCELLED once future is cancelled.
 void * get_callable_result(future_t * future);
 
-// Wait for pool threads to be completed
+// Get result from callable execution. Block if not available, but no
+// longer than abstime. Unlike the realtime deadlines of the protected
+// buffers, abstime is a CLOCK_MONOTONIC time, unaffected by changes
+// of the system clock. Return FUTURE_NOT_READY on timeout,
+// FUTURE_CANCELLED once future is cancelled.
+void * get_callable_result_timed(future_t * future, const struct timespec * abstime);
+
+// Get result from callable execution as get_callable_result_timed
+// does, but block no longer than timeout ms.
+void * get_callable_result_timeout(future_t * future, long timeout);
+
+// Get result from callable execution. Return FUTURE_NOT_READY if not
+// available, FUTURE_CANCELLED once future is cancelled.
+void * future_poll(future_t * future);
+
+// Cancel future, unless it is already completed, and wake up the
+// threads waiting for its result. A queued callable is not executed,
+// it is removed from the blocking queue at once, so that its slot is
+// available for the next submissions. A periodic callable is not
+// executed anymore from its next release. A callable being executed
+// is not interrupted. Return 1 if future was cancelled, 0 if it was
+// already completed. The submitter still has to release future.
+int future_cancel(future_t * future);
+
+// Release the reference of the submitter on future. The future must
+// not be used afterwards.
+void future_release(future_t * future);
+
+// Stop the timer thread of a scheduled executor, which completes the
+// periodic callables waiting for their next release. Close the
+// blocking queue, so that pool threads waiting for a callable wake up
+// at once. Wait for pool threads to be completed,
+// once they have executed the callables still queued.
 void executor_shutdown(executor_t * executor);
 #endif
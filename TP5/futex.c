@@ -0,0 +1,42 @@
+#include <errno.h>
+#include <time.h>
+#ifndef DARWIN
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "futex.h"
+
+#ifndef DARWIN
+// FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout, unlike
+// FUTEX_WAIT
+int futex_wait(unsigned int * word, unsigned int val, const struct timespec * abstime){
+  if (syscall(SYS_futex, word, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+              val, abstime, NULL, FUTEX_BITSET_MATCH_ANY) == -1
+      && errno == ETIMEDOUT)
+    return ETIMEDOUT;
+  return 0;
+}
+
+void futex_wake(unsigned int * word, int n){
+  syscall(SYS_futex, word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, n, NULL, NULL, 0);
+}
+#else
+int futex_wait(unsigned int * word, unsigned int val, const struct timespec * abstime){
+  struct timespec ts_now;
+  struct timespec ts_sleep = {0, 1000000};
+
+  while (__atomic_load_n(word, __ATOMIC_ACQUIRE) == val) {
+    clock_gettime(CLOCK_MONOTONIC, &ts_now);
+    if ((abstime != NULL) &&
+        ((ts_now.tv_sec > abstime->tv_sec) ||
+         ((ts_now.tv_sec == abstime->tv_sec) && (ts_now.tv_nsec >= abstime->tv_nsec))))
+      return ETIMEDOUT;
+    nanosleep(&ts_sleep, NULL);
+  }
+  return 0;
+}
+
+void futex_wake(unsigned int * word, int n){
+}
+#endif
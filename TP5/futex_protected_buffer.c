@@ -0,0 +1,244 @@
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "circular_buffer.h"
+#include "futex.h"
+#include "protected_buffer.h"
+#include "futex_protected_buffer.h"
+#include "utils.h"
+
+// State of the implementation, the impl field of protected_buffer_t
+typedef struct {
+  pthread_mutex_t     m;
+  unsigned int        not_empty_seq, not_full_seq; //futex words
+  int                 n_waiting_consumers, n_waiting_producers;
+  circular_buffer_t * buffer;
+} futex_protected_buffer_t;
+
+#define FUTEX(b) ((futex_protected_buffer_t *) ((protected_buffer_t *) (b))->impl)
+
+// Implementation based on futex words rather than condition
+// variables. The circular buffer is protected by the mutex m. The
+// not-empty and not-full conditions are two sequence words: a waiter
+// reads the word and registers itself in mutual exclusion, leaves
+// mutual exclusion and sleeps on the word as long as it keeps this
+// value. A notifier increments the word in mutual exclusion when
+// somebody is registered and wakes it up once out of mutual
+// exclusion. Timeouts are absolute CLOCK_MONOTONIC times
+// (FUTEX_WAIT_BITSET), so that they are not affected by changes of
+// the realtime clock while waiting. Closing the buffer increments
+// both words and wakes up all the threads sleeping on them.
+
+// Translate an absolute realtime timeout into an absolute monotonic
+// one
+static void futex_monotonic_time(struct timespec * abstime, struct timespec * monotime){
+  struct timespec ts_real;
+
+  clock_gettime(CLOCK_REALTIME, &ts_real);
+  clock_gettime(CLOCK_MONOTONIC, monotime);
+  monotime->tv_sec  += abstime->tv_sec - ts_real.tv_sec;
+  monotime->tv_nsec += abstime->tv_nsec - ts_real.tv_nsec;
+  if (monotime->tv_nsec < 0) {
+    monotime->tv_nsec += 1000000000;
+    monotime->tv_sec--;
+  } else if (monotime->tv_nsec >= 1000000000) {
+    monotime->tv_nsec -= 1000000000;
+    monotime->tv_sec++;
+  }
+}
+
+static int futex_not_empty(void * arg){
+  circular_buffer_t * c = FUTEX(arg)->buffer;
+  return (__atomic_load_n(&(c->tail), __ATOMIC_RELAXED)
+          != __atomic_load_n(&(c->head), __ATOMIC_RELAXED))
+    || __atomic_load_n(&(((protected_buffer_t *) arg)->closed), __ATOMIC_RELAXED);
+}
+
+static int futex_not_full(void * arg){
+  circular_buffer_t * c = FUTEX(arg)->buffer;
+  return (__atomic_load_n(&(c->tail), __ATOMIC_RELAXED)
+          - __atomic_load_n(&(c->head), __ATOMIC_RELAXED) != (unsigned int) c->max_size)
+    || __atomic_load_n(&(((protected_buffer_t *) arg)->closed), __ATOMIC_RELAXED);
+}
+
+// Leave mutual exclusion and sleep on word until it is notified, but
+// no longer than monotime when it is not NULL. The caller is counted
+// in n_waiting meanwhile. Called and return in mutual exclusion.
+static int futex_block(protected_buffer_t * b, unsigned int * word, int * n_waiting,
+                       int (*ready)(void *), int * spun, struct timespec * monotime){
+  unsigned int val = *word;
+  int rc;
+
+  // According to the waiting policy, spin once without being counted
+  if (protected_buffer_spin(b, ready, spun, &(FUTEX(b)->m))) return 0;
+  (*n_waiting)++;
+  pthread_mutex_unlock(&(FUTEX(b)->m));
+  rc = futex_wait(word, val, monotime);
+  pthread_mutex_lock(&(FUTEX(b)->m));
+  (*n_waiting)--;
+  return rc;
+}
+
+// Notify a waiter registered in n_waiting, if any. Called in mutual
+// exclusion. Return whether futex_wake must be called on word once
+// out of mutual exclusion.
+static int futex_notify(unsigned int * word, int n_waiting){
+  if (n_waiting == 0) return 0;
+  __atomic_add_fetch(word, 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+// Extract an element. When blocking, wait until there is one, but no
+// longer than abstime when it is not NULL. Return
+// PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+static void * futex_get(protected_buffer_t * b, int blocking, struct timespec * abstime){
+  struct timespec monotime;
+  void * d;
+  int    rc = 0;
+  int    spun = 0;
+  int    wake;
+
+  if (abstime != NULL) futex_monotonic_time(abstime, &monotime);
+  pthread_mutex_lock(&(FUTEX(b)->m));
+  while (((d = circular_buffer_get(FUTEX(b)->buffer)) == NULL) && blocking && (rc != ETIMEDOUT)) {
+    if (b->closed) {
+      pthread_mutex_unlock(&(FUTEX(b)->m));
+      return PROTECTED_BUFFER_CLOSED;
+    }
+    rc = futex_block(b, &(FUTEX(b)->not_empty_seq), &(FUTEX(b)->n_waiting_consumers),
+                     futex_not_empty, &spun, (abstime != NULL) ? &monotime : NULL);
+  }
+  wake = (d != NULL) && futex_notify(&(FUTEX(b)->not_full_seq), FUTEX(b)->n_waiting_producers);
+  pthread_mutex_unlock(&(FUTEX(b)->m));
+  if (wake) futex_wake(&(FUTEX(b)->not_full_seq), 1);
+  return d;
+}
+
+// Insert an element. When blocking, wait until there is room, but no
+// longer than abstime when it is not NULL. Return 0 if not successful
+// or closed.
+static int futex_put(protected_buffer_t * b, void * d, int blocking, struct timespec * abstime){
+  struct timespec monotime;
+  int    done = 0;
+  int    rc = 0;
+  int    spun = 0;
+  int    wake;
+
+  if (abstime != NULL) futex_monotonic_time(abstime, &monotime);
+  pthread_mutex_lock(&(FUTEX(b)->m));
+  while (!b->closed && ((done = circular_buffer_put(FUTEX(b)->buffer, d)) == 0) && blocking
+         && (rc != ETIMEDOUT))
+    rc = futex_block(b, &(FUTEX(b)->not_full_seq), &(FUTEX(b)->n_waiting_producers),
+                     futex_not_full, &spun, (abstime != NULL) ? &monotime : NULL);
+  wake = done && futex_notify(&(FUTEX(b)->not_empty_seq), FUTEX(b)->n_waiting_consumers);
+  pthread_mutex_unlock(&(FUTEX(b)->m));
+  if (wake) futex_wake(&(FUTEX(b)->not_empty_seq), 1);
+  return done;
+}
+
+// Initialise the protected buffer structure above.
+protected_buffer_t * futex_protected_buffer_init(int length) {
+  protected_buffer_t * b;
+  b = protected_buffer_alloc(sizeof(futex_protected_buffer_t));
+  FUTEX(b)->buffer = circular_buffer_init(length);
+  pthread_mutex_init(&(FUTEX(b)->m),NULL);
+  FUTEX(b)->not_empty_seq = 0;
+  FUTEX(b)->not_full_seq = 0;
+  FUTEX(b)->n_waiting_consumers = 0;
+  FUTEX(b)->n_waiting_producers = 0;
+  return b;
+}
+
+// Extract an element from buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+void * futex_protected_buffer_get(protected_buffer_t * b){
+  void * d = futex_get(b, 1, NULL);
+  print_task_activity ("get", (d == PROTECTED_BUFFER_CLOSED) ? NULL : d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int futex_protected_buffer_put(protected_buffer_t * b, void * d){
+  int done = futex_put(b, d, 1, NULL);
+  print_task_activity ("put", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, return NULL. Otherwise, return the element.
+void * futex_protected_buffer_remove(protected_buffer_t * b){
+  void * d = futex_get(b, 0, NULL);
+  print_task_activity ("remove", d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, return 0. Otherwise, return 1.
+int futex_protected_buffer_add(protected_buffer_t * b, void * d){
+  int done = futex_put(b, d, 0, NULL);
+  print_task_activity ("add", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return the element if
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
+void * futex_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
+  void * d = futex_get(b, 1, abstime);
+  print_task_activity ("poll", (d == PROTECTED_BUFFER_CLOSED) ? NULL : d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int futex_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
+  int done = futex_put(b, d, 1, abstime);
+  print_task_activity ("offer", done ? d : NULL);
+  return done;
+}
+
+// Close buffer and wake up all the waiting threads at once.
+void futex_protected_buffer_close(protected_buffer_t * b){
+  pthread_mutex_lock(&(FUTEX(b)->m));
+  __atomic_store_n(&(b->closed), 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&(FUTEX(b)->not_empty_seq), 1, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&(FUTEX(b)->not_full_seq), 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&(FUTEX(b)->m));
+  futex_wake(&(FUTEX(b)->not_empty_seq), INT_MAX);
+  futex_wake(&(FUTEX(b)->not_full_seq), INT_MAX);
+}
+
+// Free buffer and its synchronisation components.
+void futex_protected_buffer_destroy(protected_buffer_t * b){
+  circular_buffer_destroy(FUTEX(b)->buffer);
+  pthread_mutex_destroy(&(FUTEX(b)->m));
+  protected_buffer_free(b);
+}
+
+// Operations of this implementation, registered in protected_buffer.c
+const protected_buffer_ops_t futex_protected_buffer_ops = {
+  "futex",
+  futex_protected_buffer_init,
+  futex_protected_buffer_get,
+  futex_protected_buffer_put,
+  futex_protected_buffer_remove,
+  futex_protected_buffer_add,
+  futex_protected_buffer_poll,
+  futex_protected_buffer_offer,
+  futex_protected_buffer_put_all,
+  futex_protected_buffer_add_n,
+  futex_protected_buffer_drain_to,
+  futex_protected_buffer_poll_n,
+  futex_protected_buffer_close,
+  futex_protected_buffer_destroy
+};
@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "circular_buffer.h"
+#include "protected_buffer.h"
+
+// Microbenchmark for the circular buffer used by the protected
+// buffers. Each thread repeatedly enters a mutex, puts an element,
+// leaves, enters again and gets an element back, which is the
+// critical section executed by cond_protected_buffer_add/remove. The
+// "modulo" ring is the former implementation (first, last and size
+// updated with %), the "mask" ring is circular_buffer_t.
+//
+// Then, pairs of producer and consumer threads exchange elements
+// through protected_buffer_put and protected_buffer_get for each
+// implementation of the protected buffer.
+
+#define MAX_THREADS 64
+
+typedef struct {
+  int first, last, size, max_size;
+  void ** buffer;
+} modulo_buffer_t;
+
+modulo_buffer_t * modulo_buffer_init(int max_size) {
+  modulo_buffer_t * b = (modulo_buffer_t *)malloc(sizeof(modulo_buffer_t));
+  b->first = 0;
+  b->last  = -1;
+  b->size = 0;
+  b->max_size = max_size;
+  b->buffer = (void *)malloc(max_size*sizeof(void *));
+  return b;
+}
+
+void * modulo_buffer_get(modulo_buffer_t * b){
+  void * d;
+  if (b->size == 0) return NULL;
+  d = b->buffer[b->first];
+  b->first = (b-> first + 1) % b->max_size;
+  b->size--;
+  return d;
+}
+
+int modulo_buffer_put(modulo_buffer_t * b, void * d){
+  if (b->size == b->max_size) return 0;
+  b->last = (b->last + 1) % b->max_size;
+  b->buffer[b->last] = d;
+  b->size++;
+  return 1;
+}
+
+pthread_mutex_t     bench_mutex;
+modulo_buffer_t   * modulo_buffer;
+circular_buffer_t * mask_buffer;
+long                n_ops;
+
+void * main_modulo(void * arg) {
+  long i;
+  for (i = 0; i < n_ops; i++) {
+    pthread_mutex_lock(&bench_mutex);
+    modulo_buffer_put(modulo_buffer, arg);
+    pthread_mutex_unlock(&bench_mutex);
+    pthread_mutex_lock(&bench_mutex);
+    modulo_buffer_get(modulo_buffer);
+    pthread_mutex_unlock(&bench_mutex);
+  }
+  return NULL;
+}
+
+void * main_mask(void * arg) {
+  long i;
+  for (i = 0; i < n_ops; i++) {
+    pthread_mutex_lock(&bench_mutex);
+    circular_buffer_put(mask_buffer, arg);
+    pthread_mutex_unlock(&bench_mutex);
+    pthread_mutex_lock(&bench_mutex);
+    circular_buffer_get(mask_buffer);
+    pthread_mutex_unlock(&bench_mutex);
+  }
+  return NULL;
+}
+
+// Run n_threads threads executing main and return the number of
+// operations (put or get) per second.
+double run(int n_threads, void * (*main)(void *)) {
+  pthread_t       tasks[MAX_THREADS];
+  struct timespec t0, t1;
+  double          elapsed;
+  int             i;
+
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < n_threads; i++)
+    pthread_create(&tasks[i], NULL, main, &n_ops);
+  for (i = 0; i < n_threads; i++)
+    pthread_join(tasks[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+
+  elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1E9;
+  return (2.0 * n_ops * n_threads) / elapsed;
+}
+
+protected_buffer_t * protected_buffer;
+
+void * main_producer(void * arg) {
+  long i;
+  for (i = 0; i < n_ops; i++)
+    protected_buffer_put(protected_buffer, arg);
+  return NULL;
+}
+
+void * main_consumer(void * arg) {
+  long i;
+
+  (void) arg;
+  for (i = 0; i < n_ops; i++)
+    protected_buffer_get(protected_buffer);
+  return NULL;
+}
+
+// Run n_pairs producers and n_pairs consumers on a protected buffer
+// of implementation impl and return the number of operations (put or
+// get) per second.
+double run_buffer(long impl, int size, int n_pairs) {
+  pthread_t       tasks[MAX_THREADS];
+  struct timespec t0, t1;
+  double          elapsed;
+  int             i;
+
+  protected_buffer = protected_buffer_init(impl, size);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < n_pairs; i++) {
+    pthread_create(&tasks[2 * i], NULL, main_consumer, NULL);
+    pthread_create(&tasks[2 * i + 1], NULL, main_producer, &n_ops);
+  }
+  for (i = 0; i < 2 * n_pairs; i++)
+    pthread_join(tasks[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  protected_buffer_destroy(protected_buffer);
+
+  elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1E9;
+  return (2.0 * n_ops * n_pairs) / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+  int n_threads;
+  int size;
+
+  if (argc != 3) {
+    printf("Usage : %s <buffer size> <operations per thread>\n", argv[0]);
+    exit(1);
+  }
+  size  = atoi(argv[1]);
+  n_ops = atol(argv[2]);
+
+  pthread_mutex_init(&bench_mutex, NULL);
+  modulo_buffer = modulo_buffer_init(size);
+  mask_buffer   = circular_buffer_init(size);
+
+  printf("%8s %16s %16s\n", "threads", "modulo ops/s", "mask ops/s");
+  for (n_threads = 1; n_threads <= MAX_THREADS; n_threads = n_threads * 2) {
+    printf("%8d %16.0f %16.0f\n", n_threads,
+           run(n_threads, main_modulo),
+           run(n_threads, main_mask));
+  }
+
+  printf("\n%8s %16s %16s %16s %16s %16s\n", "threads", "cond ops/s",
+         "sem ops/s", "futex ops/s", "mpmc ops/s", "spsc ops/s");
+  for (n_threads = 2; n_threads <= MAX_THREADS; n_threads = n_threads * 2) {
+    printf("%8d %16.0f %16.0f %16.0f %16.0f", n_threads,
+           run_buffer(COND_IMPL, size, n_threads / 2),
+           run_buffer(SEM_IMPL, size, n_threads / 2),
+           run_buffer(FUTEX_IMPL, size, n_threads / 2),
+           run_buffer(MPMC_IMPL, size, n_threads / 2));
+    // A single producer and a single consumer only
+    if (n_threads == 2)
+      printf(" %16.0f\n", run_buffer(SPSC_IMPL, size, 1));
+    else
+      printf(" %16s\n", "-");
+  }
+  return 0;
+}
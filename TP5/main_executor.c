@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,10 @@
 callable_t * callables;
 future_t ** futures;
 
+// Marks the callables executed without future, there is no future to
+// release for them
+#define FUTURE_EXECUTED ((future_t *) -1)
+
 void * main_job (void * arg) {
   job_t * job = (job_t *) arg;
   struct timespec ts1, ts2;
@@ -26,7 +31,131 @@ void * main_job (void * arg) {
   return NULL;
 }
 
+#ifdef DEPS
+// Jobs are run as a DAG. A job is submitted once all the jobs it
+// depends on have completed: the last one of them to complete
+// submits it from its pool thread. No pool thread waits for a result.
+executor_t    * dag_executor;
+int           * in_degree; //predecessors of each job not completed yet
+long            n_pending; //jobs not completed yet
+long            makespan; //completion time of the last job
+pthread_mutex_t dag_m = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  dag_completed = PTHREAD_COND_INITIALIZER;
+
+void submit_dag_job (int i);
+
+// Execute job, then submit the jobs depending on it that have no
+// other predecessor left
+void * main_dag_job (void * arg) {
+  job_t * job = (job_t *) arg;
+  int     i;
+
+  main_job (arg);
+  for (i = 0; i < job_table_size; i++)
+    if (deps[i][job->id] &&
+        (__atomic_sub_fetch(&in_degree[i], 1, __ATOMIC_ACQ_REL) == 0))
+      submit_dag_job (i);
+
+  pthread_mutex_lock (&dag_m);
+  n_pending--;
+  if (n_pending == 0) {
+    makespan = relative_clock();
+    pthread_cond_signal (&dag_completed);
+  }
+  pthread_mutex_unlock (&dag_m);
+  return NULL;
+}
+
+// Submit job i. Its result is not waited for, release its future at
+// once. When the executor rejects it, execute it in the current
+// thread.
+void submit_dag_job (int i) {
+  future_t * future = submit_callable (dag_executor, &callables[i]);
+
+  if (future == NULL) {
+    printf ("%06ld [submit_callable] id %d rejected, run by caller\n", relative_clock(), i);
+    main_dag_job (callables[i].params);
+    return;
+  }
+  printf ("%06ld [submit_callable] id %d\n", relative_clock(), i);
+  future_release (future);
+}
+
+// Return the length of the critical path, the longest sum of
+// execution times along a chain of dependencies. Exit when the
+// dependencies are cyclic.
+long critical_path () {
+  long * finish = (long *) malloc (sizeof(long) * job_table_size);
+  int  * left = (int *) malloc (sizeof(int) * job_table_size);
+  long   length = 0;
+  int    n_done = 0;
+  int    progress = 1;
+  int    i, j;
+
+  // finish[i] is the earliest completion time of job i, computed
+  // once all its predecessors have theirs (left[i] == 0).
+  for (i = 0; i < job_table_size; i++) {
+    finish[i] = -1;
+    left[i] = 0;
+    for (j = 0; j < job_table_size; j++) if (deps[i][j]) left[i]++;
+  }
+  while (progress) {
+    progress = 0;
+    for (i = 0; i < job_table_size; i++) {
+      if ((finish[i] >= 0) || (left[i] != 0)) continue;
+      finish[i] = 0;
+      for (j = 0; j < job_table_size; j++)
+        if (deps[i][j] && (finish[j] > finish[i])) finish[i] = finish[j];
+      finish[i] += jobs[i].exec_time;
+      if (finish[i] > length) length = finish[i];
+      for (j = 0; j < job_table_size; j++) if (deps[j][i]) left[j]--;
+      n_done++;
+      progress = 1;
+    }
+  }
+  free (finish);
+  free (left);
+  if (n_done != job_table_size) {
+    printf ("cyclic dependencies between jobs\n");
+    exit (1);
+  }
+  return length;
+}
+
+// Submit the jobs without predecessor, wait for all the jobs to
+// complete and report the makespan against the critical path.
+void run_dag (executor_t * executor) {
+  long length = critical_path ();
+  long start;
+  int  i, j;
+
+  dag_executor = executor;
+  in_degree = (int *) malloc (sizeof(int) * job_table_size);
+  n_pending = job_table_size;
+  for (i = 0; i < job_table_size; i++) {
+    callables[i].params = (void *) &jobs[i];
+    callables[i].main   = main_dag_job;
+    callables[i].period = 0;
+    callables[i].deadline = jobs[i].deadline;
+    in_degree[i] = 0;
+    for (j = 0; j < job_table_size; j++) if (deps[i][j]) in_degree[i]++;
+  }
+
+  start = relative_clock();
+  for (i = 0; i < job_table_size; i++)
+    if (in_degree[i] == 0) submit_dag_job (i);
+
+  pthread_mutex_lock (&dag_m);
+  while (n_pending != 0) pthread_cond_wait (&dag_completed, &dag_m);
+  pthread_mutex_unlock (&dag_m);
+  printf ("%06ld [run_dag] critical path = %ld ms, makespan = %ld ms\n",
+          relative_clock(), length, makespan - start);
+}
+#endif
+
 int main(int argc, char *argv[]) {
+  pool_thread_attr_t thread_attr;
+  int reason = 0; //why the last rejected callable was aborted
   int i;
 
   if (argc != 2) {
@@ -48,30 +177,82 @@ int main(int argc, char *argv[]) {
 
   set_start_time();
 
+  // Attributes of the pool threads
+  thread_attr.affinity   = affinity;
+  thread_attr.cpusets    = (unsigned long *) cpusets;
+  thread_attr.n_cpusets  = n_cpusets;
+  thread_attr.policy     = (sched_policy == 1) ? SCHED_FIFO :
+                           (sched_policy == 2) ? SCHED_RR : SCHED_OTHER;
+  thread_attr.priority   = sched_priority;
+  thread_attr.stack_size = stack_size;
+
   // Create an executor composed of a thread pool configured with
   // core_pool_size and max_pool_size, a blocking queue (for pending
   // callables) of size blocking_queue_size and a timeout
   // keep_alive_time used to detect the idle threads that have to be
   // deallocated.
+  // With scheduled set, periodic callables do not keep a pool thread
+  // between their releases, a timer thread releases them.
   executor_t * executor =
-    executor_init
+    (scheduled ? scheduled_executor_init : executor_init)
     (core_pool_size,
      max_pool_size,
      keep_alive_time,
-     blocking_queue_size);
+     blocking_queue_size,
+     futures_impl,
+     &thread_attr);
+  if (edf) executor_set_edf (executor);
+  if (prestart) executor_prestart_core_threads (executor);
+  executor_set_rejection_policy (executor, rejection_policy, block_timeout);
 
-  // Each job is associated to a callable. This callable is submitted
-  // to the executor which will execute it when a thread from its
-  // threadpool becomes available.
+#ifdef DEPS
+  // Periodic callables do not complete, dependencies only apply to
+  // the other ones.
+  if (period == 0) {
+    run_dag (executor);
+    executor_shutdown(executor);
+    return 0;
+  }
+#endif
+
+  // Each job is associated to a callable. The callables are submitted
+  // at once to the executor which will execute them when threads from
+  // its threadpool become available.
   for (i = 0; i < job_table_size; i++) {
     callables[i].params = (void *) &jobs[i];
     callables[i].main   = main_job;
     callables[i].period = period;
+    callables[i].deadline = jobs[i].deadline;
+    callables[i].periodic_mode  = periodic_mode;
+    callables[i].overrun_policy = overrun_policy;
+  }
+
+  // When the callables are periodic, there is no result to wait for,
+  // execute them without future. The job to cancel is cancelled once
+  // submitted, its queue slot is available for the next jobs.
+  if ((period == 0) && (0 <= cancel) && (cancel < job_table_size)) {
+    if (submit_callables (executor, callables, cancel + 1, futures) < cancel + 1)
+      reason = errno;
+    if (futures[cancel] != NULL) {
+      future_cancel (futures[cancel]);
+      printf ("%06ld [future_cancel] id %ld\n", relative_clock(), cancel);
+    }
+    if (submit_callables (executor, &callables[cancel + 1], job_table_size - cancel - 1,
+                          &futures[cancel + 1]) < job_table_size - cancel - 1)
+      reason = errno;
+  } else if (period == 0) {
+    if (submit_callables (executor, callables, job_table_size, futures) < job_table_size)
+      reason = errno;
+  } else
+    for (i = 0; i < job_table_size; i++) {
+      futures[i] = execute_callable (executor, &callables[i]) ? FUTURE_EXECUTED : NULL;
+      if (futures[i] == NULL) reason = errno;
+    }
 
-    // Submit callable to executor
-    futures[i] = submit_callable (executor, &callables[i]);
+  for (i = 0; i < job_table_size; i++) {
     if (futures[i] == NULL)
-      printf ("%06ld [submit_callable] id %d failed\n", relative_clock(), i);
+      printf ("%06ld [submit_callable] id %d failed (%s)\n", relative_clock(), i,
+              strerror (reason));
     else
       printf ("%06ld [submit_callable] id %d\n", relative_clock(), i);
   }
@@ -85,12 +266,31 @@ int main(int argc, char *argv[]) {
         // Get result from future associated to callable. Suspend until
         // result becomes available.
         result = get_callable_result (futures[i]);
-        printf ("%06ld [get_callable_result] id %d\n", relative_clock(), i);
+        printf ("%06ld [get_callable_result] id %d%s\n", relative_clock(), i,
+                (result == FUTURE_CANCELLED) ? " cancelled" : "");
+        future_release (futures[i]);
       }
     }
+  } else {
+    // Let the periodic callables run for a while
+    sleep (10);
   }
-  sleep (10);
   executor_shutdown(executor);
+
+  // Report how much the callables with a deadline fell behind
+  for (i = 0; i < job_table_size; i++)
+    if ((futures[i] != NULL) && ((period != 0) || (jobs[i].deadline != 0)))
+      printf ("%06ld [main] id %d missed %ld skipped %ld max lateness %ld ms\n",
+              relative_clock(), i, callables[i].n_missed,
+              callables[i].n_skipped, callables[i].max_lateness);
+
+  // Report how the submissions were handled when the executor was
+  // saturated
+  printf ("%06ld [main] aborted %ld caller runs %ld discarded newest %ld"
+          " discarded oldest %ld blocked %ld timeouts %ld\n",
+          relative_clock(), executor->n_aborted, executor->n_caller_runs,
+          executor->n_discarded_newest, executor->n_discarded_oldest,
+          executor->n_blocked, executor->n_block_timeouts);
 }
 
 
@@ -0,0 +1,39 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+// Bounded lock-free queue for multiple producers and multiple
+// consumers (D. Vyukov). Each cell carries a sequence number telling
+// whether it is ready to be written or read at a given position, so
+// that producers and consumers only compete on their own position
+// counter with a compare and swap. The number of cells is the size
+// rounded up to a power of two, and at least two, but the queue holds
+// no more than size elements.
+typedef struct {
+  unsigned long sequence;
+  void *        data;
+} mpmc_cell_t;
+
+typedef struct {
+  mpmc_cell_t * cells;
+  unsigned long mask;
+  unsigned long capacity; //size requested at initialisation
+  // enqueue_pos and dequeue_pos sit on separate cache lines
+  unsigned long enqueue_pos __attribute__((aligned(64)));
+  unsigned long dequeue_pos __attribute__((aligned(64)));
+} mpmc_queue_t;
+
+// Allocate and initialize the queue structure
+mpmc_queue_t * mpmc_queue_init(int size);
+
+// Free the queue structure and its cells
+void mpmc_queue_destroy(mpmc_queue_t * q);
+
+// Remove an element from queue. When empty, return NULL.
+void * mpmc_queue_get(mpmc_queue_t * q);
+
+// Append an element into queue. When full, return 0.
+int mpmc_queue_put(mpmc_queue_t * q, void * d);
+
+// Return the number of elements. The value is exact only when no
+// operation is in progress.
+int mpmc_queue_size(mpmc_queue_t * q);
+#endif
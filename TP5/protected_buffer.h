@@ -1,29 +1,101 @@
 #ifndef PROTECTED_BUFFER_H
 #define PROTECTED_BUFFER_H
 #include <pthread.h>
-#include <semaphore.h>
 #include <stdlib.h>
-#include "circular_buffer.h"
+#include <time.h>
+#include "adaptive_wait.h"
 
-// Protected buffer structure used for both implemantations.
+// Available implementations of the protected buffer
+#define COND_IMPL 0 // mutex and condition variables
+#define SEM_IMPL  1 // semaphores
+#define SPSC_IMPL 2 // lock-free, single producer and single consumer
+#define MPMC_IMPL 3 // lock-free, multiple producers and consumers
+#define FUTEX_IMPL 4 // mutex and futex words
+
+// Returned by get and poll once the buffer is closed and empty
+#define PROTECTED_BUFFER_CLOSED ((void *) -1)
+
+struct _protected_buffer_t;
+
+// Operations of one implementation. Each implementation exports a
+// table of its operations (for instance cond_protected_buffer_ops),
+// registered in protected_buffer.c. The protected_buffer_* functions
+// below call the operations of the table selected at initialisation.
 typedef struct {
-  long                sem_impl;
-  pthread_cond_t      empty,full; //declares conditions attributes for buffer structure
-  pthread_mutex_t     m; //declares mutex attribute for buffer structure
-  circular_buffer_t * buffer;
+  char * name;
+  struct _protected_buffer_t * (*init)(int length);
+  void * (*get)(struct _protected_buffer_t * b);
+  int    (*put)(struct _protected_buffer_t * b, void * d);
+  void * (*remove)(struct _protected_buffer_t * b);
+  int    (*add)(struct _protected_buffer_t * b, void * d);
+  void * (*poll)(struct _protected_buffer_t * b, struct timespec * abstime);
+  int    (*offer)(struct _protected_buffer_t * b, void * d, struct timespec * abstime);
+  int    (*put_all)(struct _protected_buffer_t * b, void ** d, int n);
+  int    (*add_n)(struct _protected_buffer_t * b, void ** d, int n);
+  int    (*drain_to)(struct _protected_buffer_t * b, void ** out, int max);
+  int    (*poll_n)(struct _protected_buffer_t * b, void ** out, int max,
+                   struct timespec * abstime);
+  void   (*close)(struct _protected_buffer_t * b);
+  void   (*destroy)(struct _protected_buffer_t * b);
+} protected_buffer_ops_t;
+
+// Protected buffer structure used for all implemantations. It holds
+// the fields common to all of them. The state of the implementation
+// is opaque, allocated by its init and freed by its destroy.
+typedef struct _protected_buffer_t {
+  const protected_buffer_ops_t * ops; //operations of the implementation
+  int                 closed; //set by protected_buffer_close
+  int                 size; //number of elements it may hold
+  int                 wait_policy; //PARK_POLICY or SPIN_POLICY (see adaptive_wait.h)
+  int                 spin_limit; //self-tuned spin budget (SPIN_POLICY)
+  void              * impl; //state of the implementation
 } protected_buffer_t;
 
-// Initialise the protected buffer structure above. sem_impl specifies
-// whether the implementation is a semaphore based implementation.
-protected_buffer_t * protected_buffer_init(long sem_impl, int length);
+// Initialise the protected buffer structure above. impl selects one
+// of the implementations above, COND_IMPL when unknown.
+//
+// When compiled with -DPROTECTED_BUFFER_IMPL=<name> (cond, sem, spsc,
+// mpmc or futex), impl is ignored: the protected_buffer_* functions
+// call the functions of that implementation directly rather than
+// through its table of operations.
+protected_buffer_t * protected_buffer_init(long impl, int length);
+
+// Initialise the protected buffer structure above with the
+// implementation of the given name ("cond", "sem", "spsc", "mpmc" or
+// "futex"). Return NULL when unknown.
+protected_buffer_t * protected_buffer_init_by_name(char * name, int length);
+
+// Allocate a protected buffer structure and the state of its
+// implementation, impl_size bytes aligned on a cache line. Called by
+// the init of the implementations.
+protected_buffer_t * protected_buffer_alloc(size_t impl_size);
+
+// Free a protected buffer structure and the state of its
+// implementation. Called by the destroy of the implementations.
+void protected_buffer_free(protected_buffer_t * b);
+
+// Select how blocking operations wait: PARK_POLICY parks the thread
+// at once, SPIN_POLICY spins and yields for a self-tuned while before
+// parking.
+void protected_buffer_set_wait_policy(protected_buffer_t * b, int policy);
+
+// Called by the implementations before parking in a blocking
+// operation. With SPIN_POLICY, spin once per operation until ready(b),
+// out of the mutual exclusion m held by the caller, if not NULL.
+// Return 1 when the caller should retry rather than park: ready(b)
+// became true, or m was released meanwhile. Otherwise, return 0.
+int protected_buffer_spin(protected_buffer_t * b, int (*ready)(void *), int * spun,
+                          pthread_mutex_t * m);
 
 // Extract an element from buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
 void * protected_buffer_get(protected_buffer_t * b);
 
 // Insert an element into buffer. If the attempted operation is
 // not possible immedidately, the method call blocks until it is.
-void protected_buffer_put(protected_buffer_t * b, void * d);
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int protected_buffer_put(protected_buffer_t * b, void * d);
 
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, return NULL. Otherwise, return the element.
@@ -36,7 +108,8 @@ int protected_buffer_add(protected_buffer_t * b, void * d);
 // Extract an element from buffer. If the attempted operation is not
 // possible immedidately, the method call blocks until it is, but
 // waits no longer than the given timeout. Return the element if
-// successful. Otherwise, return NULL.
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
 void * protected_buffer_poll(protected_buffer_t * b, struct timespec * abstime);
 
 // Insert an element into buffer. If the attempted operation is not
@@ -44,4 +117,40 @@ void * protected_buffer_poll(protected_buffer_t * b, struct timespec * abstime);
 // waits no longer than the given timeout. Return 0 if not
 // successful. Otherwise, return 1.
 int protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime);
+
+// Insert the n elements of d into buffer. If there is not enough
+// room, the method call blocks until there is. Each run of elements
+// is inserted under a single lock acquisition and wakeup. Return the
+// number of elements inserted, n unless the buffer is closed.
+int protected_buffer_put_all(protected_buffer_t * b, void ** d, int n);
+
+// Insert the first elements of d, at most n, into buffer. Do not
+// block. Return the number of elements inserted.
+int protected_buffer_add_n(protected_buffer_t * b, void ** d, int n);
+
+// Extract at most max elements from buffer into out. Do not block.
+// Return the number of elements extracted.
+int protected_buffer_drain_to(protected_buffer_t * b, void ** out, int max);
+
+// Extract at most max elements from buffer into out. If the buffer is
+// empty, the method call blocks until it is not, but waits no longer
+// than the given timeout. When abstime is NULL, do not block, as
+// protected_buffer_drain_to. Return the number of elements extracted.
+int protected_buffer_poll_n(protected_buffer_t * b, void ** out, int max,
+                            struct timespec * abstime);
+// Close buffer and wake up all the waiting threads at once. Then,
+// insertions fail without blocking. Extractions return the remaining
+// elements and do not block once the buffer is empty.
+void protected_buffer_close(protected_buffer_t * b);
+
+// Free buffer. No thread may use it anymore.
+void protected_buffer_destroy(protected_buffer_t * b);
+
+// Batch operations for the implementations without their own. They
+// move the elements one at a time with the single element operations.
+int protected_buffer_put_each(protected_buffer_t * b, void ** d, int n);
+int protected_buffer_add_each(protected_buffer_t * b, void ** d, int n);
+int protected_buffer_remove_each(protected_buffer_t * b, void ** out, int max);
+int protected_buffer_poll_each(protected_buffer_t * b, void ** out, int max,
+                               struct timespec * abstime);
 #endif
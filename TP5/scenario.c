@@ -4,6 +4,7 @@
 #include <errno.h>
 
 #include "scenario.h"
+#include "utils.h"
 
 long      job_table_size;
 long      core_pool_size;
@@ -11,7 +12,25 @@ long      max_pool_size;
 long      blocking_queue_size;
 long      keep_alive_time;
 long      period;
+long      futures_impl = COND_IMPL;
+long      scheduled = 0;
+long      periodic_mode = 0;
+long      overrun_policy = 0;
+long      edf = 0;
+long      affinity = 0;
+long      n_cpusets = 0;
+long    * cpusets = NULL;
+long      sched_policy = 0;
+long      sched_priority = 0;
+long      stack_size = 0;
+long      prestart = 0;
+long      rejection_policy = 0;
+long      block_timeout = 0;
+long      cancel = -1;
 job_t   * jobs;
+#ifdef DEPS
+bool   ** deps;
+#endif
 
 int getString (FILE * f, char * s, char * file, int line) {
   char b[64];
@@ -42,6 +61,87 @@ int getLong (FILE * f, long * l, char * file, int line) {
   return 0;
 }
 
+// Look for optional section #deadline in file f. It provides the
+// relative deadline of each job, one per line. If the section is not
+// found, the jobs have no deadline. Restore the file position in any
+// case.
+void getOptionalDeadlines (FILE * f) {
+  char b[64];
+  char * c;
+  long position = ftell (f);
+  long i;
+
+  while (fgets (b, 64, f) != NULL) {
+    c = strchr (b, '\n');
+    if (c != NULL) *c = '\0';
+    if (strcmp ("#deadline", b) == 0) {
+      for (i = 0; i < job_table_size; i++)
+        getLong (f, &jobs[i].deadline, __FILE__, __LINE__);
+      break;
+    }
+  }
+  fseek (f, position, SEEK_SET);
+}
+
+// Look for optional section #cpusets in file f. It provides the
+// number of cpusets, then one cpuset per line, as a bit mask written
+// in decimal (bit i for cpu i). Restore the file position in any
+// case.
+void getOptionalCpusets (FILE * f) {
+  char b[64];
+  char * c;
+  long position = ftell (f);
+  long i;
+
+  while (fgets (b, 64, f) != NULL) {
+    c = strchr (b, '\n');
+    if (c != NULL) *c = '\0';
+    if (strcmp ("#cpusets", b) == 0) {
+      getLong (f, &n_cpusets, __FILE__, __LINE__);
+      cpusets = (long *) malloc (n_cpusets * sizeof(long));
+      for (i = 0; i < n_cpusets; i++)
+        getLong (f, &cpusets[i], __FILE__, __LINE__);
+      break;
+    }
+  }
+  fseek (f, position, SEEK_SET);
+}
+
+#ifdef DEPS
+// Look for optional section #deps in file f. It provides one line per
+// job i, made of job_table_size values. The value j is 1 when job i
+// depends on job j. If the section is not found, there is no
+// dependency. Restore the file position in any case.
+void getOptionalDeps (FILE * f) {
+  char b[64];
+  char * c;
+  long position = ftell (f);
+  long value;
+  long i, j;
+
+  deps = (bool **) malloc ((ulong) job_table_size * sizeof(bool *));
+  for (i = 0; i < job_table_size; i++)
+    deps[i] = (bool *) calloc ((ulong) job_table_size, sizeof(bool));
+
+  while (fgets (b, 64, f) != NULL) {
+    c = strchr (b, '\n');
+    if (c != NULL) *c = '\0';
+    if (strcmp ("#deps", b) == 0) {
+      for (i = 0; i < job_table_size; i++)
+        for (j = 0; j < job_table_size; j++) {
+          if (fscanf (f, "%ld", &value) != 1) {
+            printf ("getOptionalDeps failed to read deps[%ld][%ld]\n", i, j);
+            exit (1);
+          }
+          deps[i][j] = (value != 0);
+        }
+      break;
+    }
+  }
+  fseek (f, position, SEEK_SET);
+}
+#endif
+
 void readFile (char * filename) {
   FILE * file;
   ulong i;
@@ -84,5 +184,62 @@ void readFile (char * filename) {
   
   for (i = 0; i < job_table_size; i++) {
     jobs[i].id = i;
+    jobs[i].deadline = 0;
   }
+
+  // Optional: relative deadlines of the jobs
+  getOptionalDeadlines (file);
+
+#ifdef DEPS
+  // Optional: dependencies between jobs
+  getOptionalDeps (file);
+#endif
+
+  // Optional: protected buffer implementation of the executor queue
+  get_optional_long (file, "#futures_impl", &futures_impl);
+  printf ("futures_impl = %ld\n", futures_impl);
+
+  // Optional: periodic callables released by a timer thread
+  get_optional_long (file, "#scheduled", &scheduled);
+  printf ("scheduled = %ld\n", scheduled);
+
+  // Optional: FIXED_RATE or FIXED_DELAY, and overrun policy of the
+  // fixed rate periodic callables
+  get_optional_long (file, "#periodic_mode", &periodic_mode);
+  printf ("periodic_mode = %ld\n", periodic_mode);
+  get_optional_long (file, "#overrun_policy", &overrun_policy);
+  printf ("overrun_policy = %ld\n", overrun_policy);
+
+  // Optional: earliest deadline first rather than FIFO executor queue
+  get_optional_long (file, "#edf", &edf);
+  printf ("edf = %ld\n", edf);
+
+  // Optional: attributes of the pool threads (see thread_pool.h).
+  // sched_policy is 0 for SCHED_OTHER, 1 for SCHED_FIFO and 2 for
+  // SCHED_RR.
+  getOptionalCpusets (file);
+  get_optional_long (file, "#affinity", &affinity);
+  printf ("affinity = %ld\n", affinity);
+  get_optional_long (file, "#sched_policy", &sched_policy);
+  printf ("sched_policy = %ld\n", sched_policy);
+  get_optional_long (file, "#sched_priority", &sched_priority);
+  printf ("sched_priority = %ld\n", sched_priority);
+  get_optional_long (file, "#stack_size", &stack_size);
+  printf ("stack_size = %ld\n", stack_size);
+
+  // Optional: start the core pool threads before the submissions
+  get_optional_long (file, "#prestart", &prestart);
+  printf ("prestart = %ld\n", prestart);
+
+  // Optional: rejection policy of the executor (see executor.h) and
+  // timeout in ms of REJECT_BLOCK
+  get_optional_long (file, "#rejection_policy", &rejection_policy);
+  printf ("rejection_policy = %ld\n", rejection_policy);
+  get_optional_long (file, "#block_timeout", &block_timeout);
+  printf ("block_timeout = %ld\n", block_timeout);
+
+  // Optional: id of the job cancelled right after its submission,
+  // before the next jobs are submitted
+  get_optional_long (file, "#cancel", &cancel);
+  printf ("cancel = %ld\n", cancel);
 }
@@ -5,6 +5,7 @@ typedef short bool;
 typedef struct {
   int    id;
   long   exec_time;
+  long   deadline; //relative deadline in ms, 0 for none
 } job_t;
   
 
@@ -14,8 +15,25 @@ extern long      max_pool_size;
 extern long      blocking_queue_size;
 extern long      keep_alive_time;
 extern long      period;
+extern long      futures_impl;
+extern long      scheduled;
+extern long      periodic_mode;
+extern long      overrun_policy;
+extern long      edf;
+extern long      affinity;
+extern long      n_cpusets;
+extern long   *  cpusets;
+extern long      sched_policy;
+extern long      sched_priority;
+extern long      stack_size;
+extern long      prestart;
+extern long      rejection_policy;
+extern long      block_timeout;
+extern long      cancel;
 extern job_t  *  jobs;
 #ifdef DEPS
+// deps[i][j] is true when job i depends on job j, that is job i
+// cannot start before job j completes.
 extern bool   ** deps;
 #endif
 
@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "circular_buffer.h"
+#include "protected_buffer.h"
+#include "spsc_protected_buffer.h"
+#include "utils.h"
+
+// State of the implementation, the impl field of protected_buffer_t.
+// The fields of the producer side and of the consumer side are each
+// on their own cache line, apart from the shared fields.
+typedef struct {
+  pthread_cond_t      empty, full; //parked producer and consumer
+  pthread_mutex_t     m;
+  circular_buffer_t * buffer;
+  unsigned int        cached_head __attribute__((aligned(64))); //last head seen by the producer
+  int                 waiting_producer; //parked producer
+  unsigned int        cached_tail __attribute__((aligned(64))); //last tail seen by the consumer
+  int                 waiting_consumer; //parked consumer
+} spsc_protected_buffer_t;
+
+#define SPSC(b) ((spsc_protected_buffer_t *) ((protected_buffer_t *) (b))->impl)
+
+// Lock-free implementation for exactly one producer and one
+// consumer. Only the consumer writes head and only the producer
+// writes tail, they publish them with release stores and read the
+// other one with acquire loads. Each side caches the last value it
+// read from the other side and reloads it only when the buffer looks
+// empty (or full). The mutex and the condition variables are used
+// only to park a side when the buffer is really empty (or full), or
+// to wake both sides up when it is closed.
+
+// Wake up the other side if it is parked. The fence orders the
+// publication of head (or tail) before reading the waiting flag, and
+// pairs with the one in spsc_park.
+static void spsc_wake(protected_buffer_t * b, int * waiting, pthread_cond_t * cond){
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&(SPSC(b)->m));
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&(SPSC(b)->m));
+  }
+}
+
+static int spsc_closed(protected_buffer_t * b){
+  return __atomic_load_n(&(b->closed), __ATOMIC_SEQ_CST);
+}
+
+// Return whether the consumer can get an element or the buffer is
+// closed
+static int spsc_not_empty(void * arg){
+  protected_buffer_t * b = (protected_buffer_t *) arg;
+  return (__atomic_load_n(&(SPSC(b)->buffer->tail), __ATOMIC_SEQ_CST) != SPSC(b)->buffer->head)
+    || spsc_closed(b);
+}
+
+// Return whether the producer can put an element or the buffer is
+// closed
+static int spsc_not_full(void * arg){
+  protected_buffer_t * b = (protected_buffer_t *) arg;
+  return (SPSC(b)->buffer->tail - __atomic_load_n(&(SPSC(b)->buffer->head), __ATOMIC_SEQ_CST)
+          != (unsigned int) SPSC(b)->buffer->max_size)
+    || spsc_closed(b);
+}
+
+// Park the calling side until ready returns true, but no longer than
+// abstime when it is not NULL. Return ETIMEDOUT on timeout.
+static int spsc_park(protected_buffer_t * b, int * waiting, pthread_cond_t * cond,
+                     int (*ready)(void *), struct timespec * abstime){
+  int rc = 0;
+
+  pthread_mutex_lock(&(SPSC(b)->m));
+  __atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+  while (!ready(b) && (rc != ETIMEDOUT)) {
+    if (abstime == NULL)
+      pthread_cond_wait(cond, &(SPSC(b)->m));
+    else
+      rc = pthread_cond_timedwait(cond, &(SPSC(b)->m), abstime);
+  }
+  __atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&(SPSC(b)->m));
+  return rc;
+}
+
+// Extract an element from buffer if any. Consumer side only.
+static void * spsc_try_get(protected_buffer_t * b){
+  circular_buffer_t * c = SPSC(b)->buffer;
+  unsigned int head = c->head;
+  void * d;
+
+  if (head == SPSC(b)->cached_tail) {
+    SPSC(b)->cached_tail = __atomic_load_n(&(c->tail), __ATOMIC_ACQUIRE);
+    if (head == SPSC(b)->cached_tail) return NULL;
+  }
+  d = c->buffer[head & c->mask];
+  __atomic_store_n(&(c->head), head + 1, __ATOMIC_RELEASE);
+  spsc_wake(b, &(SPSC(b)->waiting_producer), &(SPSC(b)->empty));
+  return d;
+}
+
+// Insert an element into buffer if not full. Producer side only.
+static int spsc_try_put(protected_buffer_t * b, void * d){
+  circular_buffer_t * c = SPSC(b)->buffer;
+  unsigned int tail = c->tail;
+
+  if (tail - SPSC(b)->cached_head == (unsigned int) c->max_size) {
+    SPSC(b)->cached_head = __atomic_load_n(&(c->head), __ATOMIC_ACQUIRE);
+    if (tail - SPSC(b)->cached_head == (unsigned int) c->max_size) return 0;
+  }
+  c->buffer[tail & c->mask] = d;
+  __atomic_store_n(&(c->tail), tail + 1, __ATOMIC_RELEASE);
+  spsc_wake(b, &(SPSC(b)->waiting_consumer), &(SPSC(b)->full));
+  return 1;
+}
+
+// Initialise the protected buffer structure above.
+protected_buffer_t * spsc_protected_buffer_init(int length) {
+  protected_buffer_t * b;
+  b = protected_buffer_alloc(sizeof(spsc_protected_buffer_t));
+  SPSC(b)->buffer = circular_buffer_init(length);
+  SPSC(b)->cached_head = 0;
+  SPSC(b)->cached_tail = 0;
+  SPSC(b)->waiting_producer = 0;
+  SPSC(b)->waiting_consumer = 0;
+  pthread_mutex_init(&(SPSC(b)->m),NULL);
+  pthread_cond_init(&(SPSC(b)->empty),NULL);
+  pthread_cond_init(&(SPSC(b)->full),NULL);
+  return b;
+}
+
+// Extract an element from buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return PROTECTED_BUFFER_CLOSED once the buffer is closed and empty.
+void * spsc_protected_buffer_get(protected_buffer_t * b){
+  void * d;
+  int    spun = 0;
+
+  while ((d = spsc_try_get(b)) == NULL) {
+    // Elements inserted before close are visible once closed is
+    if (spsc_closed(b)) {
+      d = spsc_try_get(b);
+      break;
+    }
+    if (!protected_buffer_spin(b, spsc_not_empty, &spun, NULL))
+      spsc_park(b, &(SPSC(b)->waiting_consumer), &(SPSC(b)->full), spsc_not_empty, NULL);
+  }
+  print_task_activity ("get", d);
+  return (d == NULL) ? PROTECTED_BUFFER_CLOSED : d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, the method call blocks until it is.
+// Return 0 if the buffer is closed. Otherwise, return 1.
+int spsc_protected_buffer_put(protected_buffer_t * b, void * d){
+  int done = 0;
+  int spun = 0;
+
+  while (!spsc_closed(b) && !(done = spsc_try_put(b, d)))
+    if (!protected_buffer_spin(b, spsc_not_full, &spun, NULL))
+      spsc_park(b, &(SPSC(b)->waiting_producer), &(SPSC(b)->empty), spsc_not_full, NULL);
+  print_task_activity ("put", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, return NULL. Otherwise, return the element.
+void * spsc_protected_buffer_remove(protected_buffer_t * b){
+  void * d = spsc_try_get(b);
+  print_task_activity ("remove", d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is
+// not possible immedidately, return 0. Otherwise, return 1.
+int spsc_protected_buffer_add(protected_buffer_t * b, void * d){
+  int done = !spsc_closed(b) && spsc_try_put(b, d);
+  print_task_activity ("add", done ? d : NULL);
+  return done;
+}
+
+// Extract an element from buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return the element if
+// successful, PROTECTED_BUFFER_CLOSED once the buffer is closed and
+// empty. Otherwise, return NULL.
+void * spsc_protected_buffer_poll(protected_buffer_t * b, struct timespec *abstime){
+  void * d;
+  int    spun = 0;
+
+  while ((d = spsc_try_get(b)) == NULL) {
+    if (spsc_closed(b)) {
+      if ((d = spsc_try_get(b)) != NULL) break;
+      print_task_activity ("poll", NULL);
+      return PROTECTED_BUFFER_CLOSED;
+    }
+    if (protected_buffer_spin(b, spsc_not_empty, &spun, NULL)) continue;
+    if (spsc_park(b, &(SPSC(b)->waiting_consumer), &(SPSC(b)->full),
+                  spsc_not_empty, abstime) == ETIMEDOUT) {
+      d = spsc_try_get(b);
+      break;
+    }
+  }
+  print_task_activity ("poll", d);
+  return d;
+}
+
+// Insert an element into buffer. If the attempted operation is not
+// possible immedidately, the method call blocks until it is, but
+// waits no longer than the given timeout. Return 0 if not
+// successful. Otherwise, return 1.
+int spsc_protected_buffer_offer(protected_buffer_t * b, void * d, struct timespec * abstime){
+  int done = 0;
+  int spun = 0;
+
+  while (!spsc_closed(b) && !(done = spsc_try_put(b, d))) {
+    if (protected_buffer_spin(b, spsc_not_full, &spun, NULL)) continue;
+    if (spsc_park(b, &(SPSC(b)->waiting_producer), &(SPSC(b)->empty),
+                  spsc_not_full, abstime) == ETIMEDOUT) {
+      done = spsc_try_put(b, d);
+      break;
+    }
+  }
+  print_task_activity ("offer", done ? d : NULL);
+  return done;
+}
+
+// Close buffer and wake up both sides. The store is made before
+// taking the mutex, so that a side about to park sees it.
+void spsc_protected_buffer_close(protected_buffer_t * b){
+  __atomic_store_n(&(b->closed), 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_lock(&(SPSC(b)->m));
+  pthread_cond_broadcast(&(SPSC(b)->full));
+  pthread_cond_broadcast(&(SPSC(b)->empty));
+  pthread_mutex_unlock(&(SPSC(b)->m));
+}
+
+// Free buffer and its synchronisation components.
+void spsc_protected_buffer_destroy(protected_buffer_t * b){
+  circular_buffer_destroy(SPSC(b)->buffer);
+  pthread_mutex_destroy(&(SPSC(b)->m));
+  pthread_cond_destroy(&(SPSC(b)->empty));
+  pthread_cond_destroy(&(SPSC(b)->full));
+  protected_buffer_free(b);
+}
+
+// Operations of this implementation, registered in protected_buffer.c
+const protected_buffer_ops_t spsc_protected_buffer_ops = {
+  "spsc",
+  spsc_protected_buffer_init,
+  spsc_protected_buffer_get,
+  spsc_protected_buffer_put,
+  spsc_protected_buffer_remove,
+  spsc_protected_buffer_add,
+  spsc_protected_buffer_poll,
+  spsc_protected_buffer_offer,
+  spsc_protected_buffer_put_all,
+  spsc_protected_buffer_add_n,
+  spsc_protected_buffer_drain_to,
+  spsc_protected_buffer_poll_n,
+  spsc_protected_buffer_close,
+  spsc_protected_buffer_destroy
+};
@@ -1,4 +1,9 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "thread_pool.h"
@@ -6,18 +11,93 @@
 
 // Create a thread pool. This pool must be protected against
 // concurrent accesses.
-thread_pool_t * thread_pool_init(int core_pool_size, int max_pool_size) {
+thread_pool_t * thread_pool_init(int core_pool_size, int max_pool_size,
+                                 pool_thread_attr_t * attr) {
   thread_pool_t * thread_pool;
 
   thread_pool = (thread_pool_t *) malloc(sizeof(thread_pool_t));
   thread_pool->core_pool_size = core_pool_size;
   thread_pool->max_pool_size  = max_pool_size;
   thread_pool->size           = 0;
+  thread_pool->shutdown       = 0;
   pthread_mutex_init(&(thread_pool->m),NULL); //init mutex into thread_pool structure
   pthread_cond_init(&(thread_pool->cond_var),NULL); //init conditional variable for pool structure
+  if (attr != NULL)
+    thread_pool->attr = *attr;
+  else
+    memset (&(thread_pool->attr), 0, sizeof(pool_thread_attr_t));
+  thread_pool->n_created = 0;
   return thread_pool;
 }
 
+#ifndef DARWIN
+// Set into set the cpus of pool thread k, according to the affinity
+// of the pool. Return 0 when the thread may run anywhere.
+static int pool_thread_cpuset (pool_thread_attr_t * attr, long k, cpu_set_t * set) {
+  unsigned long mask;
+  int           n_cpus = 0;
+  int           cpu;
+
+  if ((attr->affinity == AFFINITY_NONE) || (attr->n_cpusets == 0)) return 0;
+  CPU_ZERO (set);
+  if (attr->affinity == AFFINITY_PER_WORKER) {
+    mask = attr->cpusets[k % attr->n_cpusets];
+    for (cpu = 0; cpu < (int) (8 * sizeof(unsigned long)); cpu++)
+      if (mask & (1UL << cpu)) CPU_SET (cpu, set);
+    return 1;
+  }
+
+  // Round robin: pick the (k % n_cpus)-th cpu of the cpuset
+  mask = attr->cpusets[0];
+  for (cpu = 0; cpu < (int) (8 * sizeof(unsigned long)); cpu++)
+    if (mask & (1UL << cpu)) n_cpus++;
+  if (n_cpus == 0) return 0;
+  k = k % n_cpus;
+  for (cpu = 0; ; cpu++)
+    if ((mask & (1UL << cpu)) && (k-- == 0)) break;
+  CPU_SET (cpu, set);
+  return 1;
+}
+#endif
+
+// Create pool thread k with the attributes of the pool. When they are
+// refused (the real-time policies require privileges for instance),
+// report it and use the default attributes. Return 0 if successful,
+// the error of pthread_create otherwise.
+static int pool_thread_start (thread_pool_t * thread_pool, main_func_t main,
+                               void * arg, long k) {
+  pool_thread_attr_t * attr = &(thread_pool->attr);
+  pthread_attr_t       thread_attr;
+  struct sched_param   param;
+  pthread_t            thread;
+  int                  rc;
+#ifndef DARWIN
+  cpu_set_t            set;
+#endif
+
+  pthread_attr_init (&thread_attr);
+  if (attr->stack_size != 0)
+    pthread_attr_setstacksize (&thread_attr, attr->stack_size);
+  if (attr->policy != SCHED_OTHER) {
+    pthread_attr_setinheritsched (&thread_attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy (&thread_attr, attr->policy);
+    param.sched_priority = attr->priority;
+    pthread_attr_setschedparam (&thread_attr, &param);
+  }
+#ifndef DARWIN
+  if (pool_thread_cpuset (attr, k, &set))
+    pthread_attr_setaffinity_np (&thread_attr, sizeof(cpu_set_t), &set);
+#endif
+  rc = pthread_create (&thread, &thread_attr, main, arg);
+  pthread_attr_destroy (&thread_attr);
+  if (rc != 0) {
+    printf ("%06ld [pool_thread] attributes refused (%s), default ones used\n",
+            relative_clock(), strerror (rc));
+    rc = pthread_create (&thread, NULL, main, arg);
+  }
+  return rc;
+}
+
 // Create a thread. If the number of threads created is not greater
 // than core_pool_size, create a new thread. If it is and force is set
 // to true, create a new thread. If a thread is created, use run as a
@@ -26,43 +106,75 @@ int pool_thread_create (thread_pool_t * thread_pool,
 			main_func_t     main,
 			void          * future,
 			int             force) {
-  int done = 0;
-  pthread_t thread;
+  return pool_threads_create (thread_pool, main, &future, 1, force);
+}
+
+// Reserve up to n slots, one per element of futures, under a single
+// acquisition of the pool mutex. Then, create the threads out of
+// mutual exclusion, so that concurrent submissions do not wait for
+// thread creations.
+int pool_threads_create (thread_pool_t * thread_pool,
+			 main_func_t     main,
+			 void         ** futures,
+			 int             n,
+			 int             force) {
+  int  done = 0;
+  long first;
+  int  rc = 0;
+  int  i;
 
   // Protect structure against concurrent accesses
 
   pthread_mutex_lock(&(thread_pool->m)); //lock m
 
-  // Always create a thread as long as there are less then
-  // core_pool_size threads created.
+  // Always reserve a slot as long as there are less then
+  // core_pool_size threads created. If force is true, reserve slots
+  // as long as there are less than max_pool_size threads created.
 
-  if (thread_pool->size < thread_pool->core_pool_size) {
-    pthread_create(&thread,NULL,main,future); //creates new thread in pool if there is free space
+  while ((done < n) &&
+         ((thread_pool->size < thread_pool->core_pool_size) ||
+          (force && (thread_pool->size < thread_pool->max_pool_size)))) {
     thread_pool->size ++; //incremente size parameter
-    done = 1; //set done to 1 if thread created
-  } else if (force && thread_pool->size < thread_pool->max_pool_size) {
-    pthread_create(&thread,NULL,main,future); //if no free space in corepoolsize but there is in maxpool and force is true creates new thread
-    done = 1;
-    thread_pool->size ++;
+    done ++;
   }
+  first = thread_pool->n_created;
+  thread_pool->n_created += done;
 
   // Do not protect the structure against concurrent accesses anymore
 
   pthread_mutex_unlock(&(thread_pool->m));
-  if (done)
+  for (i = 0; i < done; i++) {
+    rc = pool_thread_start (thread_pool, main, futures[i], first + i); //creates new thread in a reserved slot
+    if (rc != 0) break;
     printf("%06ld [pool_thread] created\n", relative_clock());
-  return done;
+  }
+
+  // When a creation fails, give the slots of the threads not created
+  // back, so that the pool may still become empty. Their elements are
+  // left to the caller.
+  if (i < done) {
+    printf ("%06ld [pool_thread] not created (%s)\n", relative_clock(), strerror (rc));
+    pthread_mutex_lock(&(thread_pool->m));
+    thread_pool->size -= done - i;
+    if (thread_pool->size == 0)
+      pthread_cond_broadcast(&(thread_pool->cond_var));
+    pthread_mutex_unlock(&(thread_pool->m));
+  }
+  return i;
 }
 
 void thread_pool_shutdown(thread_pool_t * thread_pool) {
+  pthread_mutex_lock(&(thread_pool->m));
   thread_pool->shutdown = 1;
+  pthread_mutex_unlock(&(thread_pool->m));
 }
 
 // When a thread wants to be deallocated, check whether the number of
-// threads already allocated is large enough. If so, decrease threads
-// number and broadcast update. Protect against concurrent accesses.
+// threads already allocated is large enough, or whether the pool is
+// shut down. If so, decrease threads number and broadcast update.
+// Protect against concurrent accesses.
 int pool_thread_remove (thread_pool_t * thread_pool) {
-  int done = 1;
+  int done = 0;
 
   // Protect against concurrent accesses and check whether the thread
   // can be deallocated.
@@ -71,10 +183,10 @@ int pool_thread_remove (thread_pool_t * thread_pool) {
 
   if (thread_pool->size > thread_pool->core_pool_size) {
     thread_pool->size--; //if threads created outnumber core_pool_size
-  }
-
-  if (thread_pool->shutdown) {
+    done = 1;
+  } else if (thread_pool->shutdown) {
     thread_pool->size--; //if shutdown is true size is decreased
+    done = 1;
   }
 
   if (thread_pool->size==0) {
@@ -104,5 +216,19 @@ void wait_thread_pool_empty (thread_pool_t * thread_pool) {
 }  
 
 int get_shutdown(thread_pool_t * thread_pool) {
-  return thread_pool->shutdown;
+  int shutdown;
+
+  pthread_mutex_lock(&(thread_pool->m));
+  shutdown = thread_pool->shutdown;
+  pthread_mutex_unlock(&(thread_pool->m));
+  return shutdown;
+}
+
+int get_size(thread_pool_t * thread_pool) {
+  int size;
+
+  pthread_mutex_lock(&(thread_pool->m));
+  size = thread_pool->size;
+  pthread_mutex_unlock(&(thread_pool->m));
+  return size;
 }
\ No newline at end of file
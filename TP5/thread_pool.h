@@ -2,11 +2,31 @@
 #define THREAD_POOL_H
 
 #include <pthread.h>
+#include <stddef.h>
 
 #include "protected_buffer.h"
 
 typedef void * (*main_func_t)(void *);
 
+// Affinity of the pool threads, the k-th thread created being
+// numbered k
+#define AFFINITY_NONE        0 //run anywhere
+#define AFFINITY_PER_WORKER  1 //thread k runs on cpusets[k % n_cpusets]
+#define AFFINITY_ROUND_ROBIN 2 //thread k runs on a single cpu of cpusets[0], in turn
+
+// Attributes of the pool threads. A cpuset is a bit mask, bit i
+// standing for cpu i. policy is SCHED_OTHER, SCHED_FIFO or SCHED_RR,
+// priority applies to the last two. A stack_size of 0 keeps the
+// default size. All zeros are the default attributes.
+typedef struct {
+  int             affinity;
+  unsigned long * cpusets;
+  int             n_cpusets;
+  int             policy;
+  int             priority;
+  size_t          stack_size;
+} pool_thread_attr_t;
+
 typedef struct {
   int             core_pool_size;
   int             max_pool_size;
@@ -14,11 +34,20 @@ typedef struct {
   int             shutdown;
   pthread_mutex_t         m; //declare mutex for pool structure
   pthread_cond_t          cond_var; //declare conditional variable for pool structure
+  pool_thread_attr_t      attr; //attributes of the pool threads
+  long                    n_created; //threads created so far
 } thread_pool_t;
 
+// size counts the threads created and the ones being created, for
+// which a slot is reserved. The threads are created out of mutual
+// exclusion.
+
 // Create a thread pool. This pool must be protected against
-// concurrent accesses.
-thread_pool_t * thread_pool_init(int core_pool_size, int max_pool_size);
+// concurrent accesses. The pool threads are created with attributes
+// attr, the default ones when NULL. The cpusets of attr are not
+// copied.
+thread_pool_t * thread_pool_init(int core_pool_size, int max_pool_size,
+                                 pool_thread_attr_t * attr);
 
 // If the current thread pool size is not greater than core_pool_size,
 // create a new thread. If it is and force is true, create a new
@@ -29,11 +58,23 @@ int pool_thread_create(thread_pool_t * thread_pool,
                        void          * executor,
                        int             force);
 
+// Create up to n threads as pool_thread_create does, under a single
+// acquisition of the pool mutex. The thread i uses args[i] as main
+// parameter. Return the number of threads created, for the first
+// elements of args. The slots of the threads that could not be
+// created are released.
+int pool_threads_create(thread_pool_t * thread_pool,
+                        main_func_t     main,
+                        void         ** args,
+                        int             n,
+                        int             force);
+
 // Shutdown
 void thread_pool_shutdown(thread_pool_t * thread_pool);
 
-// Getter
+// Getters
 int get_shutdown(thread_pool_t * thread_pool);
+int get_size(thread_pool_t * thread_pool);
 
 // Decrease thread number and broadcast update. Return whether thread
 // was actually removed.
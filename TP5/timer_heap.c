@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include "timer_heap.h"
+
+timer_heap_t * timer_heap_init(int size) {
+  timer_heap_t * h = (timer_heap_t *)malloc(sizeof(timer_heap_t));
+
+  if (size < 1) size = 1;
+  h->entries = (timer_entry_t *)malloc(size * sizeof(timer_entry_t));
+  h->size = size;
+  h->length = 0;
+  h->seq = 0;
+  return h;
+}
+
+int timespec_before(struct timespec * t1, struct timespec * t2) {
+  return (t1->tv_sec < t2->tv_sec) ||
+    ((t1->tv_sec == t2->tv_sec) && (t1->tv_nsec < t2->tv_nsec));
+}
+
+// The children of entry i are entries 2i+1 and 2i+2. An entry is never
+// later than its children. Entries at the same time are ordered by
+// insertion, so that the heap is stable.
+
+// Return whether entry e1 comes strictly before entry e2
+static int entry_before(timer_entry_t * e1, timer_entry_t * e2) {
+  return timespec_before(&(e1->time), &(e2->time)) ||
+    (!timespec_before(&(e2->time), &(e1->time)) && (e1->seq < e2->seq));
+}
+
+// Restore the heap order below entry i, whose children are heaps
+static void sift_down(timer_heap_t * h, int i) {
+  timer_entry_t entry = h->entries[i];
+  int           child;
+
+  while ((child = 2 * i + 1) < h->length) {
+    if ((child + 1 < h->length) &&
+        entry_before(&(h->entries[child + 1]), &(h->entries[child])))
+      child++;
+    if (!entry_before(&(h->entries[child]), &entry)) break;
+    h->entries[i] = h->entries[child];
+    i = child;
+  }
+  h->entries[i] = entry;
+}
+
+void timer_heap_insert(timer_heap_t * h, struct timespec * time, void * d) {
+  timer_entry_t entry;
+  int           i;
+  int           parent;
+
+  if (h->length == h->size) {
+    h->size = 2 * h->size;
+    h->entries = (timer_entry_t *)realloc(h->entries, h->size * sizeof(timer_entry_t));
+  }
+  entry.time = *time;
+  entry.data = d;
+  entry.seq  = h->seq++;
+  // Move the later parents down until the new entry fits
+  for (i = h->length++; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+    if (!entry_before(&entry, &(h->entries[parent]))) break;
+    h->entries[i] = h->entries[parent];
+  }
+  h->entries[i] = entry;
+}
+
+timer_entry_t * timer_heap_first(timer_heap_t * h) {
+  if (h->length == 0) return NULL;
+  return &(h->entries[0]);
+}
+
+void * timer_heap_remove_first(timer_heap_t * h) {
+  void * d;
+
+  if (h->length == 0) return NULL;
+  d = h->entries[0].data;
+  // Move the last entry first, then the earlier children up until it
+  // fits
+  h->entries[0] = h->entries[--h->length];
+  if (h->length > 0) sift_down(h, 0);
+  return d;
+}
+
+int timer_heap_remove_each(timer_heap_t * h, int (*match)(void *), void ** out) {
+  int removed = 0;
+  int kept = 0;
+  int i;
+
+  for (i = 0; i < h->length; i++)
+    if (match(h->entries[i].data))
+      out[removed++] = h->entries[i].data;
+    else
+      h->entries[kept++] = h->entries[i];
+  if (removed == 0) return 0;
+  // The entries kept keep their times and sequence numbers, rebuild
+  // the heap bottom-up
+  h->length = kept;
+  for (i = kept / 2 - 1; i >= 0; i--)
+    sift_down(h, i);
+  return removed;
+}
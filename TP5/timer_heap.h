@@ -0,0 +1,43 @@
+#ifndef TIMER_HEAP_H
+#define TIMER_HEAP_H
+#include <time.h>
+// Binary min-heap of elements keyed on an absolute time. The first
+// element is the one with the earliest time, the first inserted one
+// among the elements at the same time. The entry array grows as
+// needed. Not protected against concurrent accesses.
+typedef struct {
+  struct timespec time;
+  void          * data;
+  unsigned long   seq; //insertion order, breaks ties between times
+} timer_entry_t;
+
+typedef struct {
+  timer_entry_t * entries;
+  int             size; //number of entries allocated
+  int             length; //number of elements in the heap
+  unsigned long   seq; //sequence number of the next insertion
+} timer_heap_t;
+
+// Allocate and initialize the heap structure, with room for size
+// elements at first
+timer_heap_t * timer_heap_init(int size);
+
+// Insert element d at time
+void timer_heap_insert(timer_heap_t * h, struct timespec * time, void * d);
+
+// Return the entry with the earliest time, without removing it. When
+// empty, return NULL.
+timer_entry_t * timer_heap_first(timer_heap_t * h);
+
+// Remove the entry with the earliest time and return its element.
+// When empty, return NULL.
+void * timer_heap_remove_first(timer_heap_t * h);
+
+// Remove the elements d for which match(d) holds and store them into
+// out, which has room for all the elements of the heap. The other
+// elements keep their order. Return the number of elements removed.
+int timer_heap_remove_each(timer_heap_t * h, int (*match)(void *), void ** out);
+
+// Return whether time t1 is strictly before time t2
+int timespec_before(struct timespec * t1, struct timespec * t2);
+#endif
@@ -108,6 +108,28 @@ int get_long (FILE * f, long * l, char * file, int line) {
   return 0;
 }
 
+// Look for optional string s in file f and read the long that follows
+// it into l. If s is not found, leave l unchanged and return 0.
+// Restore the file position in any case, so that the optional strings
+// may appear in any order.
+int get_optional_long (FILE * f, char * s, long * l) {
+  char b[64];
+  char * c;
+  long position = ftell (f);
+  int  found = 0;
+
+  while (fgets (b, 64, f) != NULL) {
+    c = strchr (b, '\n');
+    if (c != NULL) *c = '\0';
+    if (strcmp (s, b) == 0) {
+      found = get_long (f, l, __FILE__, __LINE__);
+      break;
+    }
+  }
+  fseek (f, position, SEEK_SET);
+  return found;
+}
+
 void print_task_activity(char * action, int * data) {};
 
 #ifdef DARWIN
@@ -41,4 +41,9 @@ int get_long (FILE * f, long * l, char * file, int line);
 // Read string in file f and store it in s. If there is an error,
 // provide filename and line number (file:line).
 int get_string (FILE * f, char * s, char * file, int line);
+
+// Look for optional string s in file f and read the long that follows
+// it into l. If s is not found, leave l unchanged and return 0. The
+// file position is left unchanged.
+int get_optional_long (FILE * f, char * s, long * l);
 #endif
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include "ws_deque.h"
+
+ws_deque_t * ws_deque_init(int size) {
+  ws_deque_t *  q = (ws_deque_t *)malloc(sizeof(ws_deque_t));
+  unsigned long length = 1;
+
+  while (length < (unsigned long) size) length = length << 1;
+  q->buffer = (void **)malloc(length * sizeof(void *));
+  q->mask = length - 1;
+  q->top = 0;
+  q->bottom = 0;
+  return q;
+}
+
+// The elements between top (included) and bottom (excluded) are in
+// the deque. The owner publishes a cell before moving bottom past it.
+
+int ws_deque_push(ws_deque_t * q, void * d) {
+  long b = __atomic_load_n(&(q->bottom), __ATOMIC_RELAXED);
+  long t = __atomic_load_n(&(q->top), __ATOMIC_ACQUIRE);
+
+  if ((unsigned long) (b - t) > q->mask) return 0;
+  __atomic_store_n(&(q->buffer[b & q->mask]), d, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&(q->bottom), b + 1, __ATOMIC_RELAXED);
+  return 1;
+}
+
+// The owner reserves the last cell by moving bottom back first. The
+// fence orders this store before reading top, and pairs with the one
+// in ws_deque_steal, so that a thief and the owner cannot both get
+// the last element without competing on top.
+
+void * ws_deque_take(ws_deque_t * q) {
+  long   b = __atomic_load_n(&(q->bottom), __ATOMIC_RELAXED) - 1;
+  long   t;
+  void * d = NULL;
+
+  __atomic_store_n(&(q->bottom), b, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  t = __atomic_load_n(&(q->top), __ATOMIC_RELAXED);
+  if (t <= b) {
+    d = __atomic_load_n(&(q->buffer[b & q->mask]), __ATOMIC_RELAXED);
+    if (t == b) {
+      // Last element: compete with the thieves
+      if (!__atomic_compare_exchange_n(&(q->top), &t, t + 1, 0,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        d = NULL;
+      __atomic_store_n(&(q->bottom), b + 1, __ATOMIC_RELAXED);
+    }
+  } else {
+    // Empty: restore bottom
+    __atomic_store_n(&(q->bottom), b + 1, __ATOMIC_RELAXED);
+  }
+  return d;
+}
+
+void * ws_deque_steal(ws_deque_t * q) {
+  long   t = __atomic_load_n(&(q->top), __ATOMIC_ACQUIRE);
+  long   b;
+  void * d;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  b = __atomic_load_n(&(q->bottom), __ATOMIC_ACQUIRE);
+  if (t >= b) return NULL;
+  d = __atomic_load_n(&(q->buffer[t & q->mask]), __ATOMIC_RELAXED);
+  if (!__atomic_compare_exchange_n(&(q->top), &t, t + 1, 0,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    return NULL;
+  return d;
+}
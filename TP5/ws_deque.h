@@ -0,0 +1,30 @@
+#ifndef WS_DEQUE_H
+#define WS_DEQUE_H
+// Bounded work-stealing deque (Chase and Lev, with the memory orders
+// of Le et al.). Its owner thread pushes and takes elements at the
+// bottom end without compare and swap, except for the last element.
+// Other threads steal elements at the top end, competing on top with
+// a compare and swap. The number of cells is the size rounded up to a
+// power of two.
+typedef struct {
+  void **       buffer;
+  unsigned long mask;
+  // top and bottom sit on separate cache lines
+  long          top __attribute__((aligned(64)));
+  long          bottom __attribute__((aligned(64)));
+} ws_deque_t;
+
+// Allocate and initialize the deque structure
+ws_deque_t * ws_deque_init(int size);
+
+// Push an element at the bottom end. Owner only. When full, return 0.
+int ws_deque_push(ws_deque_t * q, void * d);
+
+// Take the last pushed element at the bottom end. Owner only. When
+// empty, return NULL.
+void * ws_deque_take(ws_deque_t * q);
+
+// Steal the first pushed element at the top end. When empty, or when
+// the element was taken by another thread meanwhile, return NULL.
+void * ws_deque_steal(ws_deque_t * q);
+#endif